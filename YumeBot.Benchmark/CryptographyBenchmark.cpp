@@ -0,0 +1,230 @@
+#include <Cafe/Misc/Scope.h>
+#include <Cryptography.h>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#	define YUMEBOT_BENCHMARK_HAS_TSC 1
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#	else
+#		include <x86intrin.h>
+#	endif
+#else
+#	define YUMEBOT_BENCHMARK_HAS_TSC 0
+#endif
+
+using namespace YumeBot;
+using namespace Cryptography;
+
+namespace
+{
+	/// @brief  常见的消息大小，覆盖自单个 TLV 至较大的 Jce 包
+	constexpr std::size_t MessageSizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536 };
+
+	/// @brief  批量接口每次处理的消息数量
+	constexpr std::size_t BatchSize = 8;
+
+	constexpr SimdLevel SimdLevels[] = { SimdLevel::None, SimdLevel::Sse2, SimdLevel::Avx2 };
+
+	constexpr const char* GetSimdLevelName(SimdLevel level) noexcept
+	{
+		switch (level)
+		{
+		case SimdLevel::None:
+			return "None";
+		case SimdLevel::Sse2:
+			return "Sse2";
+		case SimdLevel::Avx2:
+			return "Avx2";
+		}
+
+		return "?";
+	}
+
+	std::uint64_t ReadTimeStampCounter() noexcept
+	{
+#if YUMEBOT_BENCHMARK_HAS_TSC
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+	struct BenchmarkResult
+	{
+		std::size_t Iterations;
+		double Seconds;
+		std::uint64_t Cycles;
+	};
+
+	/// @brief  重复执行 func 直至经过至少 minDuration
+	/// @remark 迭代次数按倍数增长，以免计时本身的开销影响较小消息的结果
+	///         TSC 以固定频率计数，在频率变化的 CPU 上得到的周期数仅为近似值
+	template <typename Func>
+	BenchmarkResult Run(std::chrono::nanoseconds minDuration, Func&& func)
+	{
+		// 预热缓存及分支预测
+		func();
+
+		std::size_t iterations = 1;
+		while (true)
+		{
+			const auto beginTime = std::chrono::steady_clock::now();
+			const auto beginCycles = ReadTimeStampCounter();
+			for (std::size_t i = 0; i < iterations; ++i)
+			{
+				func();
+			}
+			const auto endCycles = ReadTimeStampCounter();
+			const auto elapsed = std::chrono::steady_clock::now() - beginTime;
+
+			if (elapsed >= minDuration)
+			{
+				return { iterations, std::chrono::duration<double>(elapsed).count(),
+					       endCycles - beginCycles };
+			}
+
+			iterations *= 2;
+		}
+	}
+
+	/// @param  bytesPerIteration 每次迭代处理的字节数，为 0 表示不计算吞吐量
+	void Report(const char* kernel, const char* level, std::size_t bytesPerIteration,
+	            BenchmarkResult const& result)
+	{
+		const auto opsPerSecond = result.Iterations / result.Seconds;
+		std::printf("%-24s %-6s %8zu %14.0f", kernel, level, bytesPerIteration, opsPerSecond);
+
+		if (bytesPerIteration)
+		{
+			const auto totalBytes = static_cast<double>(bytesPerIteration) * result.Iterations;
+			std::printf(" %10.1f", totalBytes / result.Seconds / (1024 * 1024));
+#if YUMEBOT_BENCHMARK_HAS_TSC
+			std::printf(" %12.2f", result.Cycles / totalBytes);
+#else
+			std::printf(" %12s", "-");
+#endif
+		}
+		else
+		{
+			std::printf(" %10s %12s", "-", "-");
+		}
+
+		std::printf("\n");
+	}
+
+	std::vector<std::byte> MakeMessage(std::size_t size)
+	{
+		std::vector<std::byte> result(size);
+		Random::Fill(result);
+		return result;
+	}
+
+	void BenchmarkTea(std::chrono::nanoseconds minDuration)
+	{
+		std::byte keyBytes[16];
+		Random::Fill(keyBytes);
+		const auto key = Tea::FormatKey(keyBytes);
+		const Tea::TeaContext context{ key };
+
+		for (const auto size : MessageSizes)
+		{
+			const auto input = MakeMessage(size);
+			std::vector<std::byte> cipher(Tea::CalculateOutputSize(size));
+			std::vector<std::byte> output(cipher.size());
+
+			// 单个消息的加密为串行的块链，不受 SimdLevel 影响
+			Report("Tea::Encrypt", "-", size,
+			       Run(minDuration, [&] { Tea::Encrypt(input, output, key); }));
+
+			context.Encrypt(input, cipher);
+			std::vector<Tea::EncryptJob> jobs;
+			std::vector<std::vector<std::byte>> batchInputs(BatchSize, input);
+			std::vector<std::vector<std::byte>> batchOutputs(BatchSize, cipher);
+			for (std::size_t i = 0; i < BatchSize; ++i)
+			{
+				jobs.push_back({ batchInputs[i], batchOutputs[i], key });
+			}
+
+			for (const auto level : SimdLevels)
+			{
+				if (level > GetMaxSimdLevel())
+				{
+					break;
+				}
+
+				SetSimdLevel(level);
+				const auto levelName = GetSimdLevelName(level);
+
+				Report("Tea::Decrypt", levelName, size,
+				       Run(minDuration, [&] { Tea::Decrypt(cipher, output, key); }));
+				Report("Tea::EncryptBatch", levelName, size * BatchSize,
+				       Run(minDuration, [&] { Tea::EncryptBatch(jobs); }));
+			}
+		}
+	}
+
+	void BenchmarkMd5(std::chrono::nanoseconds minDuration)
+	{
+		for (const auto size : MessageSizes)
+		{
+			const auto input = MakeMessage(size);
+			std::byte output[16];
+
+			Report("Md5::Calculate", "-", size,
+			       Run(minDuration, [&] { Md5::Calculate(input, output); }));
+
+			std::vector<gsl::span<const std::byte>> inputs(BatchSize, input);
+			std::vector<std::array<std::byte, 16>> outputs(BatchSize);
+
+			for (const auto level : SimdLevels)
+			{
+				if (level > GetMaxSimdLevel())
+				{
+					break;
+				}
+
+				SetSimdLevel(level);
+				Report("Md5::CalculateBatch", GetSimdLevelName(level), size * BatchSize,
+				       Run(minDuration, [&] { Md5::CalculateBatch(inputs, outputs); }));
+			}
+		}
+	}
+
+	void BenchmarkEcdh(std::chrono::nanoseconds minDuration)
+	{
+		Report("Ecdh::GenerateKeyPair", "-", 0,
+		       Run(minDuration, [] { static_cast<void>(Ecdh::GenerateKeyPair()); }));
+
+		std::vector<Ecdh::KeyPair> keyPairs(BatchSize);
+		const auto result = Run(minDuration, [&] { Ecdh::GenerateKeyPairs(keyPairs); });
+		Report("Ecdh::GenerateKeyPairs", "-", 0,
+		       { result.Iterations * BatchSize, result.Seconds, result.Cycles });
+	}
+} // namespace
+
+/// @brief  输出各个实现在不同消息大小下的吞吐量
+/// @remark 用法：YumeBot.Benchmark [每项的最短运行时间（毫秒），默认为 200]
+///         批量接口的字节数为一批中所有消息的总和
+int main(int argc, char** argv)
+{
+	const std::chrono::milliseconds minDuration{ argc > 1 ? std::atoi(argv[1]) : 200 };
+
+	const auto originalLevel = GetSimdLevel();
+	CAFE_SCOPE_EXIT
+	{
+		SetSimdLevel(originalLevel);
+	};
+
+	std::printf("Max SIMD level: %s\n\n", GetSimdLevelName(GetMaxSimdLevel()));
+	std::printf("%-24s %-6s %8s %14s %10s %12s\n", "Kernel", "Level", "Bytes", "Ops/s", "MiB/s",
+	            "Cycles/Byte");
+
+	BenchmarkTea(minDuration);
+	BenchmarkMd5(minDuration);
+	BenchmarkEcdh(minDuration);
+}
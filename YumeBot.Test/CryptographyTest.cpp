@@ -1,7 +1,9 @@
+#include <Cafe/Misc/Scope.h>
 #include <Cryptography.h>
 #include <catch2/catch.hpp>
 #include <cstring>
 #include <iterator>
+#include <vector>
 
 using namespace YumeBot;
 using namespace Cafe;
@@ -12,6 +14,20 @@ TEST_CASE("Cryptography", "[Utility][Cryptography]")
 {
 	using namespace Cryptography;
 
+	SECTION("Random")
+	{
+		// 长度不为块大小的整数倍，以覆盖使用缓冲区剩余部分的情况
+		std::byte first[100]{};
+		std::byte second[100]{};
+		Random::Fill(first);
+		Random::Fill(second);
+		CHECK(std::memcmp(first, second, std::size(first)) != 0);
+		CHECK(std::any_of(std::begin(first), std::end(first), [](std::byte value) {
+			return value != std::byte{};
+		}));
+		CHECK(Random::NextUInt32() != Random::NextUInt32());
+	}
+
 	SECTION("Tea")
 	{
 		using namespace Tea;
@@ -39,6 +55,110 @@ TEST_CASE("Cryptography", "[Utility][Cryptography]")
 		REQUIRE(std::memcmp(decryptResult, text, std::size(text)) == 0);
 	}
 
+	SECTION("Tea(SimdLevel)")
+	{
+		using namespace Tea;
+
+		constexpr const char key[] = "0123456789ABCDEF";
+		const auto formattedKey = FormatKey(gsl::as_bytes(gsl::make_span(key)));
+
+		const auto originalLevel = GetSimdLevel();
+		CAFE_SCOPE_EXIT
+		{
+			SetSimdLevel(originalLevel);
+		};
+
+		// 覆盖不足一组、恰好一组及跨越多个分段的情况
+		for (const std::size_t textSize : { 1, 7, 30, 31, 63, 64, 100, 513, 4099 })
+		{
+			std::vector<std::byte> text(textSize);
+			for (std::size_t i = 0; i < textSize; ++i)
+			{
+				text[i] = static_cast<std::byte>(i * 7 + 3);
+			}
+
+			std::vector<std::byte> encrypted(CalculateOutputSize(textSize));
+			REQUIRE(Encrypt(text, encrypted, formattedKey) == encrypted.size());
+
+			for (const auto level : { SimdLevel::None, SimdLevel::Sse2, SimdLevel::Avx2 })
+			{
+				SetSimdLevel(level);
+
+				std::vector<std::byte> decrypted(encrypted.size());
+				REQUIRE(Decrypt(encrypted, decrypted, formattedKey) == textSize);
+				decrypted.resize(textSize);
+				CHECK(decrypted == text);
+			}
+		}
+	}
+
+	SECTION("Tea.TeaContext")
+	{
+		using namespace Tea;
+
+		constexpr const char key[] = "0123456789ABCDEF";
+		const TeaContext context{ gsl::as_bytes(gsl::make_span(key)) };
+
+		constexpr const char text[] = "123456789123456789";
+		const auto textSpan = gsl::as_bytes(gsl::make_span(text));
+
+		std::byte buffer[CalculateOutputSize(std::size(text))];
+		std::memcpy(buffer, text, std::size(text));
+		REQUIRE(context.EncryptInPlace(buffer, std::size(text)) == std::size(buffer));
+
+		char decryptResult[std::size(text)]{};
+		REQUIRE(Decrypt(buffer, gsl::as_writeable_bytes(gsl::make_span(decryptResult)),
+		                context.GetKey()) == std::size(text));
+		CHECK(std::memcmp(decryptResult, text, std::size(text)) == 0);
+
+		const auto plainText = context.DecryptInPlace(buffer);
+		REQUIRE(plainText.size() == textSpan.size());
+		CHECK(std::equal(plainText.begin(), plainText.end(), textSpan.begin()));
+	}
+
+	SECTION("Tea.EncryptBatch")
+	{
+		using namespace Tea;
+
+		const auto originalLevel = GetSimdLevel();
+		CAFE_SCOPE_EXIT
+		{
+			SetSimdLevel(originalLevel);
+		};
+
+		constexpr std::size_t JobCount = 11;
+		std::vector<std::vector<std::byte>> texts(JobCount);
+		std::vector<std::vector<std::byte>> outputs(JobCount);
+		std::vector<EncryptJob> jobs(JobCount);
+		for (std::size_t i = 0; i < JobCount; ++i)
+		{
+			// 长度各不相同，使各个通道在不同的时刻换入新的消息
+			texts[i].resize(i * 13);
+			for (std::size_t j = 0; j < texts[i].size(); ++j)
+			{
+				texts[i][j] = static_cast<std::byte>(i + j);
+			}
+			outputs[i].resize(CalculateOutputSize(texts[i].size()));
+
+			const auto key = static_cast<std::uint32_t>(i * 0x01010101);
+			jobs[i] = { texts[i], outputs[i], { key, key + 1, key + 2, key + 3 } };
+		}
+
+		for (const auto level : { SimdLevel::None, SimdLevel::Sse2, SimdLevel::Avx2 })
+		{
+			SetSimdLevel(level);
+			EncryptBatch(jobs);
+
+			for (std::size_t i = 0; i < JobCount; ++i)
+			{
+				std::vector<std::byte> decrypted(outputs[i].size());
+				REQUIRE(Decrypt(outputs[i], decrypted, jobs[i].Key) == texts[i].size());
+				decrypted.resize(texts[i].size());
+				CHECK(decrypted == texts[i]);
+			}
+		}
+	}
+
 	SECTION("Md5")
 	{
 		using namespace Md5;
@@ -56,4 +176,104 @@ TEST_CASE("Cryptography", "[Utility][Cryptography]")
 			REQUIRE(str == expectedResultStr.Trim());
 		});
 	}
+
+	SECTION("Md5.Context")
+	{
+		using namespace Md5;
+
+		constexpr const char test[] = "test";
+		const auto testSpan = gsl::as_bytes(gsl::make_span(test)).subspan(0, std::size(test) - 1);
+
+		std::byte expectedResult[16];
+		Calculate(testSpan, expectedResult);
+
+		Context context;
+		context.Update(testSpan.subspan(0, 1));
+		context.Update(testSpan.subspan(1));
+		std::byte result[16];
+		context.Final(result);
+		CHECK(std::memcmp(result, expectedResult, std::size(result)) == 0);
+
+		// Final 之后可以复用
+		context.Update(testSpan);
+		context.Final(result);
+		CHECK(std::memcmp(result, expectedResult, std::size(result)) == 0);
+	}
+
+	SECTION("Md5.CalculateBatch")
+	{
+		using namespace Md5;
+
+		const auto originalLevel = GetSimdLevel();
+		CAFE_SCOPE_EXIT
+		{
+			SetSimdLevel(originalLevel);
+		};
+
+		// 长度覆盖填充需要 1 个及 2 个块的情况
+		constexpr std::size_t MessageCount = 13;
+		std::vector<std::vector<std::byte>> messages(MessageCount);
+		std::vector<gsl::span<const std::byte>> inputs;
+		for (std::size_t i = 0; i < MessageCount; ++i)
+		{
+			messages[i].resize(i * 11);
+			for (std::size_t j = 0; j < messages[i].size(); ++j)
+			{
+				messages[i][j] = static_cast<std::byte>(i * j);
+			}
+			inputs.emplace_back(messages[i]);
+		}
+
+		for (const auto level : { SimdLevel::None, SimdLevel::Sse2, SimdLevel::Avx2 })
+		{
+			SetSimdLevel(level);
+
+			std::vector<std::array<std::byte, 16>> outputs(MessageCount);
+			CalculateBatch(inputs, outputs);
+
+			for (std::size_t i = 0; i < MessageCount; ++i)
+			{
+				std::array<std::byte, 16> expectedResult;
+				Calculate(messages[i], expectedResult);
+				CHECK(outputs[i] == expectedResult);
+			}
+		}
+	}
+
+	SECTION("Ecdh")
+	{
+		using namespace Ecdh;
+
+		const auto isValidPubKey = [](KeyPair const& keyPair) {
+			// 压缩形式的公钥
+			return keyPair.PubKey[0] == std::byte{ 0x02 } || keyPair.PubKey[0] == std::byte{ 0x03 };
+		};
+
+		const auto keyPair = GenerateKeyPair();
+		REQUIRE(isValidPubKey(keyPair));
+
+		std::vector<KeyPair> keyPairs(4);
+		GenerateKeyPairs(keyPairs);
+		for (auto const& item : keyPairs)
+		{
+			REQUIRE(isValidPubKey(item));
+			REQUIRE(item.PubKey != keyPair.PubKey);
+		}
+
+		KeyPairPool pool{ 8, 2 };
+		SetGlobalKeyPairPool(&pool);
+		CAFE_SCOPE_EXIT
+		{
+			SetGlobalKeyPairPool(nullptr);
+		};
+
+		// 取出的数量超过容量时将在当前线程生成
+		for (std::size_t i = 0; i < 16; ++i)
+		{
+			const auto acquired = AcquireKeyPair();
+			REQUIRE(isValidPubKey(acquired));
+			REQUIRE(acquired.PubKey != keyPair.PubKey);
+		}
+		REQUIRE(pool.GetAvailableCount() <= 8);
+	}
 }
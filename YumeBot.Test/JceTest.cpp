@@ -85,12 +85,12 @@ TEST_CASE("Jce", "[Jce]")
 
 		UniPacket packet;
 
-		packet.GetAttribute().Put(u8"SomeInt"_s, 1);
+		packet.Put(u8"SomeInt"_s, 1);
 		const auto test = std::make_shared<JceTest>();
 		test->SetTestFloat(2.0f);
 		test->SetTestInt(233);
 		test->GetTestMap()[1] = 2.0f;
-		packet.GetAttribute().Put(u8"JceTest"_s, test);
+		packet.Put(u8"JceTest"_s, test);
 
 		packet.GetRequestPacket().SetsFuncName(u8"FuncName?"_sv);
 		packet.GetRequestPacket().SetsServantName(u8"ServantName?"_sv);
@@ -104,13 +104,12 @@ TEST_CASE("Jce", "[Jce]")
 			UniPacket readPacket;
 			readPacket.Decode(&memoryStream);
 
-			const auto& attribute = readPacket.GetAttribute();
 			std::int32_t intValue;
-			REQUIRE(attribute.Get(u8"SomeInt"_s, intValue));
+			REQUIRE(readPacket.Get(u8"SomeInt"_s, intValue));
 			CHECK(intValue == 1);
 
 			std::shared_ptr<JceTest> ptrValue;
-			REQUIRE(attribute.Get(u8"JceTest"_s, ptrValue));
+			REQUIRE(readPacket.Get(u8"JceTest"_s, ptrValue));
 			REQUIRE(ptrValue);
 			CHECK(ptrValue->GetTestFloat() == 2.0f);
 			CHECK(ptrValue->GetTestInt() == 233);
@@ -121,4 +120,198 @@ TEST_CASE("Jce", "[Jce]")
 			CHECK(requestPacket.GetsServantName() == u8"ServantName?"_sv);
 		}
 	}
+
+	SECTION("Wup.UniPacket(Version3)")
+	{
+		using namespace Wup;
+
+		UniPacket packet{ UniPacket::UniAttributeVersion };
+		packet.Put(u8"SomeInt"_s, 1);
+		packet.Put(u8"SomeFloat"_s, 1.0f);
+
+		Cafe::Io::MemoryStream memoryStream;
+		packet.Encode(&memoryStream);
+
+		memoryStream.SeekFromBegin(0);
+
+		{
+			UniPacket readPacket;
+			readPacket.Decode(&memoryStream);
+
+			CHECK(readPacket.GetRequestPacket().GetiVersion() == UniPacket::UniAttributeVersion);
+			REQUIRE(std::holds_alternative<UniAttribute>(readPacket.GetAttribute()));
+
+			std::int32_t intValue;
+			REQUIRE(readPacket.Get(u8"SomeInt"_s, intValue));
+			CHECK(intValue == 1);
+
+			float floatValue;
+			REQUIRE(readPacket.Get(u8"SomeFloat"_s, floatValue));
+			CHECK(floatValue == 1.0f);
+		}
+	}
+
+	SECTION("Wup.UniPacket.EncodeBatch")
+	{
+		using namespace Wup;
+
+		UniPacket packets[3];
+		for (std::size_t i = 0; i < std::size(packets); ++i)
+		{
+			auto& packet = packets[i];
+			packet.Put(u8"SomeInt"_s, static_cast<std::int32_t>(i));
+			auto& requestPacket = packet.GetRequestPacket();
+			requestPacket.SetiRequestId(static_cast<std::int32_t>(i + 1));
+			requestPacket.SetsFuncName(u8"FuncName?"_sv);
+			requestPacket.SetsServantName(u8"ServantName?"_sv);
+		}
+
+		const auto batch = UniPacket::EncodeBatch(packets);
+		REQUIRE(batch.Offsets.size() == std::size(packets) + 1);
+		REQUIRE(batch.Offsets.back() == batch.Buffer.size());
+
+		for (std::size_t i = 0; i < std::size(packets); ++i)
+		{
+			const auto encodedPacket = gsl::make_span(batch.Buffer).subspan(
+			    batch.Offsets[i], batch.Offsets[i + 1] - batch.Offsets[i]);
+
+			Cafe::Io::MemoryStream memoryStream;
+			packets[i].Encode(&memoryStream);
+			const auto expected = memoryStream.GetInternalStorage();
+			REQUIRE(std::equal(encodedPacket.begin(), encodedPacket.end(), expected.begin(),
+			                   expected.end()));
+
+			Cafe::Io::ExternalMemoryInputStream stream{ encodedPacket };
+			UniPacket readPacket;
+			readPacket.Decode(&stream);
+
+			std::int32_t intValue;
+			REQUIRE(readPacket.Get(u8"SomeInt"_s, intValue));
+			CHECK(intValue == static_cast<std::int32_t>(i));
+			CHECK(readPacket.GetRequestPacket().GetiRequestId() == static_cast<std::int32_t>(i + 1));
+		}
+	}
+
+	SECTION("Wup.RequestCorrelator")
+	{
+		using namespace Wup;
+
+		RequestCorrelator correlator{ 4 };
+		std::vector<std::int32_t> completedIds;
+		std::size_t timeoutCount = 0;
+
+		for (std::int32_t id = 1; id <= 3; ++id)
+		{
+			RequestPacket request;
+			request.SetiRequestId(id);
+			request.SetiTimeout(id == 3 ? 1 : 0);
+			REQUIRE(correlator.Register(request, [&](UniPacket* response) {
+				if (response)
+				{
+					completedIds.emplace_back(response->GetRequestPacket().GetiRequestId());
+				}
+				else
+				{
+					++timeoutCount;
+				}
+			}));
+		}
+		CHECK(correlator.GetPendingCount() == 3);
+
+		const auto complete = [&](std::int32_t id) {
+			UniPacket response;
+			response.GetRequestPacket().SetiRequestId(id);
+			return correlator.Complete(response);
+		};
+
+		CHECK(complete(2));
+		CHECK(complete(1));
+		CHECK_FALSE(complete(2));
+		CHECK(completedIds == std::vector<std::int32_t>{ 2, 1 });
+
+		CHECK(correlator.ExpireTimedOut(RequestCorrelator::Clock::now() + std::chrono::seconds{ 1 }) ==
+		      1);
+		CHECK(timeoutCount == 1);
+		CHECK(correlator.GetPendingCount() == 0);
+
+		// 正在等待响应的 iRequestId 不能重复登记，完成后可以再次登记
+		RequestPacket request;
+		request.SetiRequestId(1);
+		REQUIRE(correlator.Register(request, {}));
+		CHECK_FALSE(correlator.Register(request, {}));
+		// 5 与 1 落在同一个槽上，将沿探测链登记到之后的槽
+		request.SetiRequestId(5);
+		REQUIRE(correlator.Register(request, {}));
+		CHECK_FALSE(correlator.Register(request, {}));
+		CHECK(correlator.GetPendingCount() == 2);
+
+		CHECK(complete(1));
+		request.SetiRequestId(1);
+		CHECK(correlator.Register(request, {}));
+		CHECK(complete(5));
+		CHECK(complete(1));
+		CHECK_FALSE(complete(1));
+		CHECK(correlator.GetPendingCount() == 0);
+	}
+
+	SECTION("Wup.RequestCorrelator(Tombstones)")
+	{
+		using namespace Wup;
+
+		constexpr std::size_t Capacity = 16;
+		// 墓碑超过 4 个时即被清理，且同时等待响应的请求不超过 2 个，连续非空的槽不会超过 8 个
+		constexpr std::size_t MaxProbeLength = 9;
+
+		RequestCorrelator correlator{ Capacity };
+		std::size_t completedCount = 0;
+		for (std::int32_t id = 1; id <= static_cast<std::int32_t>(Capacity * 8); ++id)
+		{
+			RequestPacket request;
+			request.SetiRequestId(id);
+			REQUIRE(correlator.Register(request, [&](UniPacket*) { ++completedCount; }));
+			if (id > 2)
+			{
+				UniPacket response;
+				response.GetRequestPacket().SetiRequestId(id - 2);
+				REQUIRE(correlator.Complete(response));
+			}
+
+			CHECK(correlator.GetProbeLength(id) <= MaxProbeLength);
+			// 不存在的请求的查找同样应在遇到空槽时停止
+			CHECK(correlator.GetProbeLength(-id) <= MaxProbeLength);
+		}
+
+		CHECK(completedCount == Capacity * 8 - 2);
+		CHECK(correlator.GetPendingCount() == 2);
+	}
+
+	SECTION("Wup.ServantDispatcher")
+	{
+		using namespace Wup;
+
+		ServantDispatcher dispatcher;
+		std::vector<std::int32_t> dispatched;
+		dispatcher.Register(u8"KQQConfig"_sv, u8"SignatureReq"_sv,
+		                    [&](gsl::span<const std::byte> const&) { dispatched.emplace_back(1); });
+		dispatcher.Register(u8"KQQConfig"_sv, u8"ClientReq"_sv,
+		                    [&](gsl::span<const std::byte> const&) { dispatched.emplace_back(2); });
+		dispatcher.Register(u8"ConfigService"_sv, u8"ClientReq"_sv,
+		                    [&](gsl::span<const std::byte> const&) { dispatched.emplace_back(3); });
+		dispatcher.Build();
+
+		const auto dispatch = [&](UsingStringView const& servantName, UsingStringView const& funcName) {
+			UniPacket packet;
+			packet.GetRequestPacket().SetsServantName(servantName);
+			packet.GetRequestPacket().SetsFuncName(funcName);
+
+			Cafe::Io::MemoryStream memoryStream;
+			packet.Encode(&memoryStream);
+			return dispatcher.Dispatch(memoryStream.GetInternalStorage());
+		};
+
+		CHECK(dispatch(u8"ConfigService"_sv, u8"ClientReq"_sv));
+		CHECK(dispatch(u8"KQQConfig"_sv, u8"SignatureReq"_sv));
+		CHECK_FALSE(dispatch(u8"KQQConfig"_sv, u8"Unknown"_sv));
+		CHECK(dispatched == std::vector<std::int32_t>{ 3, 1 });
+	}
 }
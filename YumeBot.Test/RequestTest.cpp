@@ -0,0 +1,222 @@
+#include <Request.h>
+#include <Utility.h>
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+
+using namespace YumeBot;
+using namespace Cafe::Encoding::StringLiterals;
+
+TEST_CASE("Request", "[Request]")
+{
+	using namespace Tlv;
+
+	SECTION("DerivedKeyCache")
+	{
+		Request::DerivedKeyCache cache;
+
+		std::array<std::byte, 16> md5{};
+		const auto key = cache.GetTgtgtKey(md5, 0, 123456).GetKey();
+		const auto expectedKey = TlvT<0x106>::CalculateEncryptKey(md5, 0, 123456);
+		CHECK(std::equal(key.begin(), key.end(), expectedKey.begin()));
+
+		// MSalt 为 0 时以 Uin 代替
+		const auto saltedKey = cache.GetTgtgtKey(md5, 123456, 654321).GetKey();
+		CHECK(std::equal(saltedKey.begin(), saltedKey.end(), expectedKey.begin()));
+
+		// 输入改变后应重新计算
+		md5[0] = std::byte{ 1 };
+		const auto changedKey = cache.GetTgtgtKey(md5, 0, 123456).GetKey();
+		const auto expectedChangedKey = TlvT<0x106>::CalculateEncryptKey(md5, 0, 123456);
+		CHECK(std::equal(changedKey.begin(), changedKey.end(), expectedChangedKey.begin()));
+
+		// const 的重载只读取已保存的值，未命中时仍应返回正确的结果
+		auto const& constCache = cache;
+		const auto cachedKey = constCache.GetTgtgtKey(md5, 0, 123456).GetKey();
+		CHECK(std::equal(cachedKey.begin(), cachedKey.end(), expectedChangedKey.begin()));
+		const auto missedKey = constCache.GetTgtgtKey(md5, 0, 654321).GetKey();
+		const auto expectedMissedKey = TlvT<0x106>::CalculateEncryptKey(md5, 0, 654321);
+		CHECK(std::equal(missedKey.begin(), missedKey.end(), expectedMissedKey.begin()));
+	}
+
+	SECTION("StaticTlvCache")
+	{
+		Request::RequestContext context;
+		context.Imei = CAFE_UTF8_SV("imei");
+
+		auto& cache = context.GetStaticTlvs();
+		const auto encode = [](auto&&... tlvs) {
+			Buffer buffer;
+			TlvBuilder builder{ buffer };
+			(builder.WriteTlv(tlvs), ...);
+			const auto data = buffer.GetSpan();
+			return std::vector<std::byte>(data.begin(), data.end());
+		};
+
+		const auto& block = cache.GetDeviceIdTlvs(context);
+		CHECK(block.TlvCount == 1);
+		CHECK(block.Data == encode(TlvT<0x109>{ context.Imei }));
+
+		// 输入改变后应重新编码
+		context.WifiMac = CAFE_UTF8_SV("mac");
+		const auto& changedBlock = cache.GetDeviceIdTlvs(context);
+		CHECK(changedBlock.TlvCount == 2);
+		CHECK(changedBlock.Data == encode(TlvT<0x187>{ context.WifiMac }, TlvT<0x109>{ context.Imei }));
+
+		// Write 系列方法命中时写入已保存的结果，未命中时直接编码
+		const auto write = [&](auto&& func) {
+			Buffer buffer;
+			TlvBuilder builder{ buffer };
+			func(builder);
+			const auto data = buffer.GetSpan();
+			return std::vector<std::byte>(data.begin(), data.end());
+		};
+		auto const& constCache = cache;
+		CHECK(write([&](TlvBuilder& builder) { constCache.WriteDeviceIdTlvs(builder, context); }) ==
+		      changedBlock.Data);
+		context.Imei = CAFE_UTF8_SV("imei2");
+		CHECK(write([&](TlvBuilder& builder) { constCache.WriteDeviceIdTlvs(builder, context); }) ==
+		      encode(TlvT<0x187>{ context.WifiMac }, TlvT<0x109>{ context.Imei }));
+
+		const auto profileBlock = cache.GetProfileTlvs(context, 1);
+		CHECK(profileBlock.TlvCount == 4);
+		CHECK(cache.GetProfileTlvs(context, 1).Data == profileBlock.Data);
+		CHECK(cache.GetProfileTlvs(context, 2).Data != profileBlock.Data);
+		CHECK(write([&](TlvBuilder& builder) { constCache.WriteProfileTlvs(builder, context, 2); }) ==
+		      cache.GetProfileTlvs(context, 2).Data);
+	}
+
+	SECTION("Seq")
+	{
+		Request::RequestContext context;
+		for (std::size_t i = 0; i <= 200; ++i)
+		{
+			REQUIRE(context.AcquireRequestSeq() == i);
+		}
+		// 递增至大于 200 时重新设为 0
+		CHECK(context.AcquireRequestSeq() == 0);
+
+		// 复制的结果与原对象互相独立
+		const auto copied = context;
+		CHECK(copied.AcquireRequestSeq() == 1);
+		CHECK(context.AcquireRequestSeq() == 1);
+
+		using Request::MsfSeq;
+
+		// 足以递增至 MaxValue 并重新随机恰好一次，逐个 REQUIRE 过慢，因此只记录结果
+		auto msfSeq = context.AcquireMsfSeq();
+		CHECK(msfSeq <= MsfSeq::InitialRange);
+		std::size_t rerandomizeCount = 0;
+		bool incremented = true;
+		bool rerandomizedInRange = true;
+		for (std::size_t i = 0; i <= MsfSeq::MaxValue; ++i)
+		{
+			const auto next = context.AcquireMsfSeq();
+			if (msfSeq < MsfSeq::MaxValue)
+			{
+				// 包括重新随机之后，seq 都应以 1 递增
+				incremented = incremented && next == msfSeq + 1;
+			}
+			else
+			{
+				++rerandomizeCount;
+				rerandomizedInRange = rerandomizedInRange && next >= MsfSeq::RerandomizeBase &&
+				                      next < MsfSeq::RerandomizeBase + MsfSeq::RerandomizeRange;
+			}
+			msfSeq = next;
+		}
+		CHECK(incremented);
+		CHECK(rerandomizedInRange);
+		CHECK(rerandomizeCount == 1);
+
+		// 多个线程同时取得的 seq 不应重复
+		constexpr std::size_t ThreadCount = 4;
+		constexpr std::size_t SeqPerThread = 50;
+		std::vector<std::size_t> seqs[ThreadCount];
+		{
+			std::vector<std::thread> threads;
+			for (auto& threadSeqs : seqs)
+			{
+				threads.emplace_back([&] {
+					for (std::size_t i = 0; i < SeqPerThread; ++i)
+					{
+						threadSeqs.push_back(context.AcquireClientSeq());
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+		std::vector<std::size_t> allSeqs;
+		for (const auto& threadSeqs : seqs)
+		{
+			allSeqs.insert(allSeqs.end(), threadSeqs.begin(), threadSeqs.end());
+		}
+		std::sort(allSeqs.begin(), allSeqs.end());
+		CHECK(std::adjacent_find(allSeqs.begin(), allSeqs.end()) == allSeqs.end());
+		CHECK(allSeqs.back() == ThreadCount * SeqPerThread - 1);
+	}
+
+	SECTION("Guid")
+	{
+		Request::RequestContext context;
+		context.Imei = CAFE_UTF8_SV("imei");
+		context.WifiMac = CAFE_UTF8_SV("mac");
+
+		const auto guid = context.GetGuid();
+		CHECK(guid == Request::RequestContext::CalculateGuid(CAFE_UTF8_SV("imei"),
+		                                                     CAFE_UTF8_SV("mac")));
+
+		// 仅在首次调用时计算
+		context.WifiMac = CAFE_UTF8_SV("mac2");
+		CHECK(context.GetGuid() == guid);
+		context.ResetGuid();
+		CHECK(context.GetGuid() != guid);
+	}
+
+	SECTION("RequestBuilder")
+	{
+		struct TestRequest : Request::RequestBase<TestRequest, 2064, 9, Request::EncryptType::Ecdh>
+		{
+			void DoWrite(TlvBuilder& tlvBuilder, Request::RequestContext const&, std::size_t seq) const
+			{
+				tlvBuilder.WriteTlv(TlvT<0x154>{ static_cast<std::uint32_t>(seq) });
+			}
+		};
+
+		Request::RequestContext context;
+		context.Uin = 123456;
+		const auto shareKey = context.GetShareKey();
+
+		Request::RequestBuilder builder{ std::move(context) };
+		Buffer frame;
+		const auto seq = builder.BuildRequest(frame, TestRequest{});
+		const auto encryptHeadSize =
+		    Request::RequestBuilder::EncryptHeadSize<Request::EncryptType::Ecdh>;
+
+		const auto result = frame.GetSpan();
+		REQUIRE(static_cast<std::size_t>(result.size()) > 1 + 27 + encryptHeadSize);
+		CHECK(result[0] == std::byte{ 2 });
+		CHECK(Utility::LoadBigEndian<std::uint16_t>(result.data() + 1) == result.size());
+		CHECK(Utility::LoadBigEndian<std::uint16_t>(result.data() + 5) == 2064);
+		CHECK(Utility::LoadBigEndian<std::uint16_t>(result.data() + 7) == seq);
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(result.data() + 9) == 123456);
+		CHECK(result[result.size() - 1] == std::byte{ 3 });
+
+		const auto bodyOffset = 1 + 27 + encryptHeadSize;
+		std::vector<std::byte> body(result.begin() + bodyOffset, result.end() - 1);
+		const auto plainText = shareKey.DecryptInPlace(body);
+		REQUIRE(plainText.size() == 4 + 8);
+		CHECK(Utility::LoadBigEndian<std::uint16_t>(plainText.data()) == 9);
+		CHECK(Utility::LoadBigEndian<std::uint16_t>(plainText.data() + 2) == 1);
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(plainText.data() + 8) == seq);
+
+		// 复用 frame 时不应重新分配空间
+		const auto data = frame.GetData();
+		builder.BuildRequest(frame, TestRequest{});
+		CHECK(frame.GetData() == data);
+	}
+}
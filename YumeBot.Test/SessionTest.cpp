@@ -0,0 +1,67 @@
+#include <Session.h>
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace YumeBot;
+
+TEST_CASE("Session", "[Session]")
+{
+	SECTION("SessionFactory.PrepareContexts")
+	{
+		Request::RequestContext commonContext;
+		commonContext.Imei = CAFE_UTF8_SV("imei");
+		SessionFactory factory{ commonContext };
+
+		// 超过一组的大小，以覆盖多个组及最后一组不满的情况
+		constexpr std::size_t AccountCount = 40;
+		std::vector<SessionFactory::Account> accounts;
+		for (std::size_t i = 0; i < AccountCount; ++i)
+		{
+			accounts.push_back({ static_cast<std::uint32_t>(10000 + i),
+			                     SessionFactory::UserPassword{ CAFE_UTF8_SV("password") } });
+			accounts.back().Password.PasswordMd5[0] = static_cast<std::byte>(i);
+		}
+
+		std::vector<std::thread> threads;
+		const Utility::Executor executor = [&](std::function<void()> task) {
+			threads.emplace_back(std::move(task));
+		};
+		const auto contexts = factory.PrepareContexts(accounts, executor);
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(threads.size() > 1);
+
+		REQUIRE(contexts.size() == AccountCount);
+		for (std::size_t i = 0; i < AccountCount; ++i)
+		{
+			const auto& context = contexts[i];
+			CHECK(context.Uin == accounts[i].Uin);
+			CHECK(context.PasswordMd5 == accounts[i].Password.PasswordMd5);
+			CHECK(context.Imei.GetView() == CAFE_UTF8_SV("imei"));
+			// 共享前应已预先取值
+			CHECK(context.IsCachePrepared());
+
+			for (std::size_t j = 0; j < i; ++j)
+			{
+				const auto& other = contexts[j].Keys;
+				CHECK(std::memcmp(context.Keys.PubKey, other.PubKey, sizeof other.PubKey) != 0);
+				CHECK(std::memcmp(context.Keys.ShareKey, other.ShareKey, sizeof other.ShareKey) != 0);
+				CHECK(std::memcmp(context.Keys.RandomKey, other.RandomKey, sizeof other.RandomKey) !=
+				      0);
+			}
+		}
+
+		// 每个上下文的 Msf seq 应分别随机
+		std::vector<std::uint32_t> msfSeqs;
+		for (const auto& context : contexts)
+		{
+			msfSeqs.push_back(context.AcquireMsfSeq());
+		}
+		CHECK(std::count(msfSeqs.begin(), msfSeqs.end(), msfSeqs.front()) < AccountCount);
+	}
+}
@@ -0,0 +1,212 @@
+#include <Sso.h>
+#include <Utility.h>
+#include <catch2/catch.hpp>
+#include <cstring>
+#include <vector>
+
+using namespace YumeBot;
+using namespace Cafe::Encoding::StringLiterals;
+
+namespace
+{
+	template <typename SizeType>
+	void AppendSized(std::vector<std::byte>& dest, gsl::span<const std::byte> const& value)
+	{
+		const auto offset = dest.size();
+		dest.resize(offset + sizeof(SizeType));
+		Utility::StoreBigEndian(dest.data() + offset,
+		                        static_cast<SizeType>(value.size() + sizeof(SizeType)));
+		dest.insert(dest.end(), value.begin(), value.end());
+	}
+
+	void AppendSized(std::vector<std::byte>& dest, UsingStringView const& value)
+	{
+		AppendSized<std::uint32_t>(dest, gsl::as_bytes(value.GetTrimmedSpan()));
+	}
+
+	template <typename T>
+	void AppendBigEndian(std::vector<std::byte>& dest, T value)
+	{
+		const auto offset = dest.size();
+		dest.resize(offset + sizeof(T));
+		Utility::StoreBigEndian(dest.data() + offset, value);
+	}
+
+	/// @brief  构造 SSO 响应包，body 加密时以 16 字节的 0 作为密钥
+	std::vector<std::byte> MakeResponse(Sso::EncryptFlag encrypt,
+	                                    gsl::span<const std::byte> const& payload)
+	{
+		std::vector<std::byte> respHead;
+		AppendBigEndian(respHead, std::uint32_t{ 0x1234 });
+		AppendBigEndian(respHead, std::int32_t{ -1 });
+		AppendSized(respHead, u8"Error"_sv);
+		AppendSized(respHead, u8"wtlogin.login"_sv);
+		const std::byte cookie[]{ std::byte{ 1 }, std::byte{ 2 }, std::byte{ 3 }, std::byte{ 4 } };
+		AppendSized<std::uint32_t>(respHead, cookie);
+		AppendBigEndian(respHead, std::uint32_t{ 0 });
+
+		std::vector<std::byte> body;
+		AppendSized<std::uint32_t>(body, respHead);
+		AppendSized<std::uint32_t>(body, payload);
+		if (encrypt != Sso::EncryptFlag::None)
+		{
+			const std::array<std::byte, 16> emptyKey{};
+			std::vector<std::byte> encrypted(Cryptography::Tea::CalculateOutputSize(body.size()));
+			Cryptography::Tea::TeaContext{ gsl::make_span(emptyKey) }.Encrypt(body, encrypted);
+			body = std::move(encrypted);
+		}
+
+		std::vector<std::byte> package;
+		AppendBigEndian(package, std::uint32_t{});
+		AppendBigEndian(package, std::uint32_t{ 8 });
+		AppendBigEndian(package, static_cast<std::uint8_t>(encrypt));
+		AppendBigEndian(package, std::uint8_t{});
+		AppendSized(package, u8"123456"_sv);
+		package.insert(package.end(), body.begin(), body.end());
+		Utility::StoreBigEndian(package.data(), static_cast<std::uint32_t>(package.size()));
+		return package;
+	}
+} // namespace
+
+TEST_CASE("Sso", "[Sso]")
+{
+	using namespace Sso;
+
+	const std::byte payload[]{ std::byte{ 0x02 }, std::byte{ 0x12 }, std::byte{ 0x34 },
+		                         std::byte{ 0x03 } };
+
+	RequestHead head{};
+	head.Version = SsoVersion::Version8;
+	head.Uin = 123456;
+	head.SsoSeq = 0x1234;
+	head.AppId = DefaultAppId;
+	head.MsfAppId = DefaultAppId;
+	head.ServiceCmd = u8"wtlogin.login"_sv;
+
+	SECTION("EncodeRequest")
+	{
+		Buffer frame{ 256 };
+		std::memcpy(frame.Append(sizeof payload).data(), payload, sizeof payload);
+		const auto payloadData = frame.GetData();
+
+		head.Encrypt = EncryptFlag::None;
+		EncodeRequest(frame, head);
+
+		const auto result = frame.GetSpan();
+		REQUIRE(result.size() > 4 + 4 + 1 + 4 + 1 + 4 + 6);
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(result.data()) == result.size());
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(result.data() + 4) == 8);
+		CHECK(result[8] == std::byte{ 0 });
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(result.data() + 9) == 4);
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(result.data() + 14) == 4 + 6);
+		CHECK(AsStringView(result.subspan(18, 6)) == u8"123456"_sv);
+
+		const auto reqHead = result.subspan(24);
+		const auto reqHeadSize = Utility::LoadBigEndian<std::uint32_t>(reqHead.data());
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(reqHead.data() + 4) == 0x1234);
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(reqHead.data() + 8) == DefaultAppId);
+		REQUIRE(reqHead.size() == reqHeadSize + 4 + sizeof payload);
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(reqHead.data() + reqHeadSize) ==
+		      4 + sizeof payload);
+
+		// 负载不应被移动或复制
+		CHECK(reqHead.data() + reqHeadSize + 4 == payloadData);
+		CHECK(std::memcmp(payloadData, payload, sizeof payload) == 0);
+	}
+
+	SECTION("EncodeRequest.EmptyKey")
+	{
+		Buffer frame{ 256 };
+		std::memcpy(frame.Append(sizeof payload).data(), payload, sizeof payload);
+
+		head.Encrypt = EncryptFlag::EmptyKey;
+		EncodeRequest(frame, head);
+
+		const auto result = frame.GetSpan();
+		CHECK(Utility::LoadBigEndian<std::uint32_t>(result.data()) == result.size());
+		CHECK(result[8] == std::byte{ 2 });
+
+		const std::array<std::byte, 16> emptyKey{};
+		std::vector<std::byte> body(result.begin() + 24, result.end());
+		const auto plainText =
+		    Cryptography::Tea::TeaContext{ gsl::make_span(emptyKey) }.DecryptInPlace(body);
+		const auto reqHeadSize = Utility::LoadBigEndian<std::uint32_t>(plainText.data());
+		REQUIRE(plainText.size() == reqHeadSize + 4 + sizeof payload);
+		CHECK(std::memcmp(plainText.data() + reqHeadSize + 4, payload, sizeof payload) == 0);
+	}
+
+	SECTION("EncodeRequest.SizeLimit")
+	{
+		Buffer frame{ 256 };
+		frame.Append(MaxPackageSize);
+
+		head.Encrypt = EncryptFlag::None;
+		CHECK_THROWS_AS(EncodeRequest(frame, head), SsoException);
+	}
+
+	SECTION("DecodeResponse")
+	{
+		for (const auto encrypt : { EncryptFlag::None, EncryptFlag::EmptyKey })
+		{
+			auto package = MakeResponse(encrypt, payload);
+			REQUIRE(GetPackageSize(package) == package.size());
+
+			const auto response = DecodeResponse(package);
+			CHECK(response.Head.Version == SsoVersion::Version8);
+			CHECK(response.Head.Encrypt == encrypt);
+			CHECK(response.Head.Uin == u8"123456"_sv);
+			CHECK(response.Head.SsoSeq == 0x1234);
+			CHECK(response.Head.ReturnCode == -1);
+			CHECK(response.Head.ErrorMessage == u8"Error"_sv);
+			CHECK(response.Head.ServiceCmd == u8"wtlogin.login"_sv);
+			CHECK(response.Head.MsgCookie.size() == 4);
+			CHECK(response.Head.CompressFlag == 0);
+
+			// 负载应为指向包内的视图
+			REQUIRE(response.Payload.size() == sizeof payload);
+			CHECK(response.Payload.data() >= package.data());
+			CHECK(response.Payload.data() + response.Payload.size() <=
+			      package.data() + package.size());
+			CHECK(std::memcmp(response.Payload.data(), payload, sizeof payload) == 0);
+		}
+	}
+
+	SECTION("DecodeResponse.Invalid")
+	{
+		auto package = MakeResponse(EncryptFlag::None, payload);
+		CHECK_THROWS_AS(DecodeResponse(gsl::make_span(package).first(package.size() - 1)),
+		                SsoException);
+
+		Utility::StoreBigEndian(package.data() + 4, std::uint32_t{ 10 });
+		CHECK_THROWS_AS(DecodeResponse(package), SsoException);
+	}
+
+	SECTION("DecodeResponse.InvalidEncryptedBody")
+	{
+		// 加密的部分从 4 + 4 + 1 + 1 + 4 + 6 处开始
+		constexpr std::size_t BodyOffset = 20;
+
+		// 长度不为块大小的整数倍
+		auto truncated = MakeResponse(EncryptFlag::EmptyKey, payload);
+		truncated.pop_back();
+		Utility::StoreBigEndian(truncated.data(), static_cast<std::uint32_t>(truncated.size()));
+		CHECK_THROWS_AS(DecodeResponse(truncated), SsoException);
+
+		// 无法以 EmptyKey 正确解密
+		auto garbage = MakeResponse(EncryptFlag::EmptyKey, payload);
+		for (std::size_t i = BodyOffset; i < garbage.size(); ++i)
+		{
+			garbage[i] = static_cast<std::byte>(i * 0x3D);
+		}
+		CHECK_THROWS_AS(DecodeResponse(garbage), SsoException);
+	}
+
+	SECTION("GetPackageSize")
+	{
+		std::byte data[4]{};
+		CHECK(!GetPackageSize(gsl::make_span(data).first(3)));
+
+		Utility::StoreBigEndian(data, static_cast<std::uint32_t>(MaxPackageSize + 1));
+		CHECK_THROWS_AS(GetPackageSize(data), SsoException);
+	}
+}
@@ -1,6 +1,8 @@
 #include <Tlv.h>
 #include <Utility.h>
+#include <algorithm>
 #include <catch2/catch.hpp>
+#include <vector>
 
 using namespace YumeBot;
 using namespace Cafe::Encoding::StringLiterals;
@@ -11,10 +13,286 @@ TEST_CASE("Tlv", "[Tlv]")
 
 	SECTION("Serialization")
 	{
-		Cafe::Io::MemoryStream stream;
+		static_assert(IsWritableTlv<0x1> && !IsPackedTlv<0x1>);
+		static_assert(IsWritableTlv<0x154> && IsPackedTlv<0x154>);
+		static_assert(!IsWritableTlv<0x305>);
+
+		Buffer buffer;
 
-		TlvBuilder builder{ &stream };
+		TlvBuilder builder{ buffer };
 		builder.WriteTlv(
 		    TlvT<1>{ .Uin = 123456, .ServerTime = Utility::GetPosixTime(), .ClientIp = {} });
+		builder.WriteTlv(TlvT<0x154>{ .SsoSeq = 0x01020304 });
+		REQUIRE(builder.GetTlvCount() == 2);
+
+		constexpr std::byte expectedResult[]{ std::byte{ 0x00 }, std::byte{ 0x01 }, std::byte{ 0x00 },
+			                                    std::byte{ 0x08 }, std::byte{ 0x00 }, std::byte{ 0x01 },
+			                                    std::byte{ 0xE2 }, std::byte{ 0x40 } };
+		const auto result = buffer.GetSpan();
+		REQUIRE(result.size() == 12 + 8);
+		CHECK(std::equal(std::begin(expectedResult), std::end(expectedResult), result.begin()));
+
+		constexpr std::byte expectedTlv154[]{ std::byte{ 0x01 }, std::byte{ 0x54 }, std::byte{ 0x00 },
+			                                    std::byte{ 0x04 }, std::byte{ 0x01 }, std::byte{ 0x02 },
+			                                    std::byte{ 0x03 }, std::byte{ 0x04 } };
+		CHECK(std::equal(std::begin(expectedTlv154), std::end(expectedTlv154), result.begin() + 12));
+	}
+
+	SECTION("EncryptedTlvContainer")
+	{
+		static_assert(IsWritableTlv<0x144> && IsEncryptedTlvContainer<0x144>);
+
+		const Cryptography::Tea::TeaContext context{ gsl::as_bytes(gsl::make_span("key")) };
+
+		Buffer buffer;
+		TlvBuilder builder{ buffer };
+		builder.WriteTlv(TlvT<0x154>{ .SsoSeq = 1 });
+		builder.WriteTlv(TlvT<0x144>{ ._153 = TlvT<0x153>{ .IsRoot = 0 },
+		                              ._16e = TlvT<0x16E>{ .DeviceName = u8"YumeBot"_sv },
+		                              .Key = context.GetKey() });
+		REQUIRE(builder.GetTlvCount() == 2);
+
+		// 期望的明文为内部 Tlv 的数量及内部 Tlv
+		Buffer expectedBuffer;
+		TlvBuilder expectedBuilder{ expectedBuffer };
+		expectedBuffer.Append(2);
+		expectedBuilder.WriteTlv(TlvT<0x153>{ .IsRoot = 0 });
+		expectedBuilder.WriteTlv(TlvT<0x16E>{ .DeviceName = u8"YumeBot"_sv });
+		Utility::StoreBigEndian(expectedBuffer.GetData(), std::uint16_t{ 2 });
+
+		const auto result = buffer.GetSpan().subspan(8);
+		REQUIRE(result.size() > 4);
+		CHECK(result[0] == std::byte{ 0x01 });
+		CHECK(result[1] == std::byte{ 0x44 });
+		const auto bodySize = std::to_integer<std::size_t>(result[2]) << 8 |
+		                      std::to_integer<std::size_t>(result[3]);
+		REQUIRE(bodySize == static_cast<std::size_t>(result.size() - 4));
+
+		std::vector<std::byte> body(result.begin() + 4, result.end());
+		const auto plainText = context.DecryptInPlace(body);
+		const auto expected = expectedBuffer.GetSpan();
+		REQUIRE(plainText.size() == expected.size());
+		CHECK(std::equal(plainText.begin(), plainText.end(), expected.begin()));
+	}
+
+	SECTION("Buffer")
+	{
+		Buffer buffer{ 4 };
+		const std::byte data[]{ std::byte{ 1 }, std::byte{ 2 }, std::byte{ 3 } };
+		for (std::size_t i = 0; i < 100; ++i)
+		{
+			buffer.WriteBytes(gsl::make_span(data));
+		}
+		REQUIRE(buffer.GetSize() == 300);
+		REQUIRE(buffer.GetHeadroom() == 4);
+
+		// 预留空间足够时不移动数据
+		const auto dataBegin = buffer.GetData();
+		buffer.Prepend(4)[0] = std::byte{ 9 };
+		CHECK(buffer.GetData() + 4 == dataBegin);
+
+		// 预留空间不足时移动数据
+		buffer.Prepend(2);
+		REQUIRE(buffer.GetSize() == 306);
+		CHECK(buffer.GetSpan()[2] == std::byte{ 9 });
+		CHECK(buffer.GetSpan()[305] == std::byte{ 3 });
+
+		buffer.Resize(7);
+		CHECK(buffer.GetSpan()[6] == std::byte{ 1 });
+	}
+
+	SECTION("DecryptStream")
+	{
+		// Ksid 跨越多个分段，以覆盖重新解密分段的情况
+		std::vector<std::byte> ksid(Cryptography::Tea::DecryptStream::ChunkSize * 2 + 5);
+		for (std::size_t i = 0; i < ksid.size(); ++i)
+		{
+			ksid[i] = static_cast<std::byte>(i);
+		}
+		const std::vector<std::byte> sessionKey(16, std::byte{ 0x05 });
+
+		Cafe::Io::MemoryStream plainStream;
+		{
+			Cafe::Io::BinaryWriter writer{ &plainStream, std::endian::big };
+			writer.Write(std::uint16_t{ 0x108 });
+			writer.Write(static_cast<std::uint16_t>(ksid.size()));
+			TlvT<0x108>{ ksid }.Write(writer);
+			writer.Write(std::uint16_t{ 0x305 });
+			writer.Write(static_cast<std::uint16_t>(sessionKey.size()));
+			plainStream.WriteBytes(gsl::make_span(sessionKey));
+		}
+
+		const auto plainText = plainStream.GetInternalStorage();
+		const Cryptography::Tea::TeaContext context{ gsl::as_bytes(gsl::make_span("key")) };
+		std::vector<std::byte> cipherText(Cryptography::Tea::CalculateOutputSize(plainText.size()));
+		context.Encrypt(plainText, cipherText);
+
+		Cryptography::Tea::DecryptStream stream{ cipherText, context };
+		REQUIRE(stream.GetTotalSize() == static_cast<std::size_t>(plainText.size()));
+
+		TlvReader reader{ &stream };
+		const auto tlv305 = reader.ReadTlv<0x305>();
+		REQUIRE(tlv305.has_value());
+		CHECK(std::equal(tlv305->SessionKey.begin(), tlv305->SessionKey.end(), sessionKey.begin(),
+		                 sessionKey.end()));
+
+		const auto tlv108 = reader.ReadTlv<0x108>();
+		REQUIRE(tlv108.has_value());
+		CHECK(std::equal(tlv108->Ksid.begin(), tlv108->Ksid.end(), ksid.begin(), ksid.end()));
+	}
+
+	SECTION("TlvReader")
+	{
+		Cafe::Io::MemoryStream stream;
+		{
+			Cafe::Io::BinaryWriter writer{ &stream, std::endian::big };
+			const auto writeTlv = [&](std::uint16_t cmd, std::vector<std::byte> const& body) {
+				writer.Write(cmd);
+				writer.Write(static_cast<std::uint16_t>(body.size()));
+				stream.WriteBytes(gsl::make_span(body));
+			};
+
+			writeTlv(0x108, { std::byte{ 1 } });
+			writeTlv(0x305, { std::byte{ 2 }, std::byte{ 3 } });
+			writeTlv(0x108, {});
+			writeTlv(0x108, { std::byte{ 4 } });
+			// Body 的大小超出流的剩余部分，应被忽略
+			writer.Write(std::uint16_t{ 0x106 });
+			writer.Write(std::uint16_t{ 100 });
+		}
+
+		TlvReader reader{ &stream };
+
+		const auto entries = reader.GetEntries();
+		REQUIRE(entries.size() == 4);
+		CHECK(entries[0].Cmd == 0x108);
+		CHECK(entries[1].Cmd == 0x305);
+		CHECK(entries[2].BodySize == 0);
+		CHECK(entries[3].Cmd == 0x108);
+		CHECK(reader.FindEntry(0x106) == nullptr);
+
+		const auto tlv305 = reader.ReadTlv<0x305>();
+		REQUIRE(tlv305.has_value());
+		CHECK(std::vector<std::byte>(tlv305->SessionKey.begin(), tlv305->SessionKey.end()) ==
+		      std::vector<std::byte>{ std::byte{ 2 }, std::byte{ 3 } });
+
+		std::vector<std::vector<std::byte>> ksids;
+		const auto count = reader.ReadAllTlv<0x108>(
+		    [&](TlvT<0x108>&& tlv) { ksids.emplace_back(tlv.Ksid.begin(), tlv.Ksid.end()); });
+		CHECK(count == 3);
+
+		const std::vector<std::vector<std::byte>> expectedKsids{ { std::byte{ 1 } },
+			                                                       {},
+			                                                       { std::byte{ 4 } } };
+		CHECK(ksids == expectedKsids);
+	}
+
+	SECTION("ReadableTlv")
+	{
+		static_assert(IsReadableTlv<0x11A> && IsReadableTlv<0x10A> && !IsReadableTlv<0x1>);
+
+		const std::byte body[]{ std::byte{ 0x00 }, std::byte{ 0x01 }, std::byte{ 18 },
+			                      std::byte{ 1 },    std::byte{ 4 },    std::byte{ 'Y' },
+			                      std::byte{ 'u' },  std::byte{ 'm' },  std::byte{ 'e' } };
+		const auto tlv11A = TlvT<0x11A>::Read(body);
+		CHECK(tlv11A.Face == 1);
+		CHECK(tlv11A.Age == 18);
+		CHECK(tlv11A.Gender == 1);
+		CHECK(tlv11A.Nick == u8"Yume"_sv.Trim());
+		// 昵称直接指向 Body
+		CHECK(static_cast<const void*>(tlv11A.Nick.GetSpan().data()) == body + 5);
+
+		CHECK_THROWS_AS(TlvT<0x11A>::Read(gsl::make_span(body).first(8)), TlvDecodeException);
+	}
+
+	SECTION("TlvResponse")
+	{
+		const Cryptography::Tea::TeaContext key{ gsl::as_bytes(gsl::make_span("key")) };
+		const std::byte ksid[]{ std::byte{ 1 } };
+		const std::byte tgt[]{ std::byte{ 2 }, std::byte{ 3 }, std::byte{ 4 } };
+
+		Buffer buffer;
+		TlvBuilder builder{ buffer };
+		builder.WriteTlv(TlvT<0x108>{ ksid });
+		builder.WriteEncryptedTlv(0x119, key, [&](TlvBuilder& innerBuilder) {
+			innerBuilder.WriteTlv(TlvT<0x10A>{ tgt });
+		});
+		const auto data = buffer.GetSpan();
+
+		TlvResponse response{ std::vector<std::byte>(data.begin(), data.end()) };
+		const auto tlv108 = response.ReadTlv<0x108>();
+		REQUIRE(tlv108.has_value());
+		CHECK(std::equal(tlv108->Ksid.begin(), tlv108->Ksid.end(), std::begin(ksid), std::end(ksid)));
+
+		// 解密失败时容器保持不变，可以正确的密钥重试
+		const auto container = response.GetReader().GetBody(*response.GetReader().FindEntry(0x119));
+		const std::vector<std::byte> encrypted(container.begin(), container.end());
+		const Cryptography::Tea::TeaContext wrongKey{ gsl::as_bytes(gsl::make_span("wrong")) };
+		CHECK_THROWS_AS(response.GetNested(0x119, wrongKey), Cryptography::CryptoException);
+		CHECK(std::equal(container.begin(), container.end(), encrypted.begin(), encrypted.end()));
+
+		const auto nested = response.GetNested(0x119, key);
+		REQUIRE(nested);
+		CHECK(response.GetNested(0x119, key) == nested);
+		CHECK(response.GetNested(0x11A, key) == nullptr);
+
+		const auto tlv10A = nested->ReadTlv<0x10A>();
+		REQUIRE(tlv10A.has_value());
+		CHECK(std::equal(tlv10A->TGT.begin(), tlv10A->TGT.end(), std::begin(tgt), std::end(tgt)));
+		// 解密后容器仍可直接读取
+		CHECK(std::equal(container.begin(), container.end(), encrypted.begin(), encrypted.end()));
+	}
+
+	SECTION("DispatchTlv")
+	{
+		static_assert(IsListedReadableTlv<0x108> && !IsListedReadableTlv<0x154>);
+		static_assert(Detail::IsCompleteReadableTlvList<ReadableTlvCmds>);
+
+		const std::byte ksid[]{ std::byte{ 1 } };
+		const std::byte tgt[]{ std::byte{ 2 }, std::byte{ 3 } };
+
+		Buffer buffer;
+		TlvBuilder builder{ buffer };
+		builder.WriteTlv(TlvT<0x108>{ ksid });
+		builder.WriteTlv(TlvT<0x154>{ .SsoSeq = 1 });
+		builder.WriteTlv(TlvT<0x10A>{ tgt });
+		builder.WriteTlv(TlvT<0x143>{ tgt });
+
+		struct Handler
+		{
+			std::vector<std::uint16_t>& HandledCmds;
+
+			void operator()(TlvT<0x108>&& tlv)
+			{
+				CHECK(tlv.Ksid.size() == 1);
+				HandledCmds.push_back(0x108);
+			}
+
+			void operator()(TlvT<0x10A>&& tlv)
+			{
+				CHECK(tlv.TGT.size() == 2);
+				HandledCmds.push_back(0x10A);
+			}
+		};
+
+		std::vector<std::uint16_t> handledCmds;
+		std::vector<std::uint16_t> fallbackCmds;
+		// 0x154 不可读取，0x143 可读取但 Handler 不接受，均应交给 fallback
+		DispatchTlv(buffer.GetSpan(), Handler{ handledCmds },
+		            [&](std::uint16_t cmd, gsl::span<const std::byte> const&) {
+			            fallbackCmds.push_back(cmd);
+		            });
+		CHECK(handledCmds == std::vector<std::uint16_t>{ 0x108, 0x10A });
+		CHECK(fallbackCmds == std::vector<std::uint16_t>{ 0x154, 0x143 });
+
+		handledCmds.clear();
+		fallbackCmds.clear();
+		TlvReader reader{ buffer.GetSpan() };
+		DispatchTlv(reader, Handler{ handledCmds },
+		            [&](std::uint16_t cmd, gsl::span<const std::byte> const&) {
+			            fallbackCmds.push_back(cmd);
+		            });
+		CHECK(handledCmds == std::vector<std::uint16_t>{ 0x108, 0x10A });
+		CHECK(fallbackCmds == std::vector<std::uint16_t>{ 0x154, 0x143 });
 	}
 }
@@ -0,0 +1,88 @@
+#include <Utility.h>
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace YumeBot;
+
+TEST_CASE("Utility", "[Utility]")
+{
+	SECTION("ParallelFor")
+	{
+		std::vector<std::thread> threads;
+		const Utility::Executor executor = [&](std::function<void()> task) {
+			threads.emplace_back(std::move(task));
+		};
+
+		std::vector<std::size_t> result(32);
+		Utility::ParallelFor(executor, result.size(), [&](std::size_t i) { result[i] = i; });
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		for (std::size_t i = 0; i < result.size(); ++i)
+		{
+			CHECK(result[i] == i);
+		}
+	}
+
+	SECTION("ParallelFor(ThrowingTask)")
+	{
+		std::vector<std::thread> threads;
+		const Utility::Executor executor = [&](std::function<void()> task) {
+			threads.emplace_back(std::move(task));
+		};
+
+		std::atomic<std::size_t> calledCount{};
+		const auto func = [&](std::size_t i) {
+			++calledCount;
+			if (i == 3)
+			{
+				throw std::runtime_error{ "task" };
+			}
+		};
+		CHECK_THROWS_AS(Utility::ParallelFor(executor, 8, func), std::runtime_error);
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		// 所有任务均应在抛出异常前完成
+		CHECK(calledCount == 8);
+	}
+
+	SECTION("ParallelFor(ThrowingExecutor)")
+	{
+		constexpr std::size_t SubmitLimit = 5;
+
+		std::vector<std::thread> threads;
+		const Utility::Executor executor = [&](std::function<void()> task) {
+			if (threads.size() == SubmitLimit)
+			{
+				throw std::runtime_error{ "executor" };
+			}
+			threads.emplace_back([task = std::move(task)] {
+				// 延迟执行，使 ParallelFor 在任务完成前观察到 executor 的异常
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+				task();
+			});
+		};
+
+		std::atomic<std::size_t> calledCount{};
+		CHECK_THROWS_AS(
+		    Utility::ParallelFor(executor, 16, [&](std::size_t) { ++calledCount; }),
+		    std::runtime_error);
+
+		// 返回时已提交的任务应已全部完成，未提交的任务不会被调用
+		CHECK(calledCount == SubmitLimit);
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(calledCount == SubmitLimit);
+	}
+}
@@ -0,0 +1,138 @@
+#include "Buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+using namespace YumeBot;
+
+Buffer::Buffer(std::size_t headroom, std::size_t initialCapacity)
+    : m_Storage{ new std::byte[headroom + initialCapacity] },
+      m_Capacity{ headroom + initialCapacity }, m_Begin{ headroom }, m_End{ headroom }
+{
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+    : m_Storage{ std::move(other.m_Storage) }, m_Capacity{ std::exchange(other.m_Capacity, 0) },
+      m_Begin{ std::exchange(other.m_Begin, 0) }, m_End{ std::exchange(other.m_End, 0) }
+{
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept
+{
+	m_Storage = std::move(other.m_Storage);
+	m_Capacity = std::exchange(other.m_Capacity, 0);
+	m_Begin = std::exchange(other.m_Begin, 0);
+	m_End = std::exchange(other.m_End, 0);
+	return *this;
+}
+
+std::size_t Buffer::WriteBytes(gsl::span<const std::byte> const& buffer)
+{
+	const auto size = static_cast<std::size_t>(buffer.size());
+	if (size)
+	{
+		std::memcpy(Append(size).data(), buffer.data(), size);
+	}
+	return size;
+}
+
+gsl::span<std::byte> Buffer::Append(std::size_t size)
+{
+	Reserve(size);
+	const auto result = m_Storage.get() + m_End;
+	m_End += size;
+	return { result, static_cast<std::ptrdiff_t>(size) };
+}
+
+gsl::span<std::byte> Buffer::Prepend(std::size_t size)
+{
+	if (m_Begin < size)
+	{
+		Reallocate(size, 0);
+	}
+
+	m_Begin -= size;
+	return { m_Storage.get() + m_Begin, static_cast<std::ptrdiff_t>(size) };
+}
+
+void Buffer::Reserve(std::size_t size)
+{
+	if (m_Capacity - m_End < size)
+	{
+		Reallocate(m_Begin, size);
+	}
+}
+
+void Buffer::Resize(std::size_t size)
+{
+	const auto currentSize = GetSize();
+	if (size > currentSize)
+	{
+		Append(size - currentSize);
+	}
+	else
+	{
+		m_End = m_Begin + size;
+	}
+}
+
+void Buffer::Clear(std::size_t headroom)
+{
+	if (m_Capacity < headroom)
+	{
+		m_Storage = std::unique_ptr<std::byte[]>{ new std::byte[headroom] };
+		m_Capacity = headroom;
+	}
+
+	m_Begin = headroom;
+	m_End = headroom;
+}
+
+std::byte* Buffer::GetData() noexcept
+{
+	return m_Storage.get() + m_Begin;
+}
+
+std::byte const* Buffer::GetData() const noexcept
+{
+	return m_Storage.get() + m_Begin;
+}
+
+std::size_t Buffer::GetSize() const noexcept
+{
+	return m_End - m_Begin;
+}
+
+std::size_t Buffer::GetHeadroom() const noexcept
+{
+	return m_Begin;
+}
+
+gsl::span<std::byte> Buffer::GetSpan() noexcept
+{
+	return { GetData(), static_cast<std::ptrdiff_t>(GetSize()) };
+}
+
+gsl::span<const std::byte> Buffer::GetSpan() const noexcept
+{
+	return { GetData(), static_cast<std::ptrdiff_t>(GetSize()) };
+}
+
+void Buffer::Reallocate(std::size_t headroom, std::size_t tailroom)
+{
+	const auto size = GetSize();
+	// 按倍数增长，以免多次追加时频繁重新分配
+	const auto capacity = std::max(headroom + size + tailroom, m_Capacity * 2);
+	auto storage = std::unique_ptr<std::byte[]>{ new std::byte[capacity] };
+	// 增长的部分分配给数据之后的空间
+	const auto begin = std::max(headroom, m_Begin);
+	if (size)
+	{
+		std::memcpy(storage.get() + begin, GetData(), size);
+	}
+
+	m_Storage = std::move(storage);
+	m_Capacity = capacity;
+	m_Begin = begin;
+	m_End = begin + size;
+}
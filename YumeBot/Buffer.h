@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Cafe/Io/Streams/StreamBase.h>
+#include <memory>
+
+namespace YumeBot
+{
+	/// @brief  连续的可增长缓冲区，可作为输出流写入
+	/// @remark 数据之前可预留空间，用于在写入数据之后以 Prepend 补充头部而不需要移动数据
+	///         增长或 Prepend 超出预留空间时，之前获得的指针及 span 将会失效
+	class Buffer : public Cafe::Io::OutputStream
+	{
+	public:
+		explicit Buffer(std::size_t headroom = 0, std::size_t initialCapacity = 0);
+
+		Buffer(Buffer&& other) noexcept;
+		Buffer& operator=(Buffer&& other) noexcept;
+
+		std::size_t WriteBytes(gsl::span<const std::byte> const& buffer) override;
+
+		/// @brief  在数据末尾追加 size 个未初始化的字节
+		/// @return 追加的空间，用户应在下次写入前填充
+		gsl::span<std::byte> Append(std::size_t size);
+
+		/// @brief  在数据之前追加 size 个未初始化的字节
+		/// @remark 预留空间不足时将移动数据
+		/// @return 追加的空间，即当前数据的起始部分
+		gsl::span<std::byte> Prepend(std::size_t size);
+
+		/// @brief  保证之后追加 size 个字节时不需要增长
+		void Reserve(std::size_t size);
+
+		/// @brief  修改数据的大小，增大时新增的字节未初始化
+		void Resize(std::size_t size);
+
+		/// @brief  清空数据并重新预留 headroom 个字节，已分配的空间将被复用
+		void Clear(std::size_t headroom = 0);
+
+		std::byte* GetData() noexcept;
+		std::byte const* GetData() const noexcept;
+
+		std::size_t GetSize() const noexcept;
+		std::size_t GetHeadroom() const noexcept;
+
+		gsl::span<std::byte> GetSpan() noexcept;
+		gsl::span<const std::byte> GetSpan() const noexcept;
+
+	private:
+		std::unique_ptr<std::byte[]> m_Storage;
+		std::size_t m_Capacity;
+		/// @brief  数据在 m_Storage 中的范围为 [m_Begin, m_End)
+		std::size_t m_Begin;
+		std::size_t m_End;
+
+		/// @brief  重新分配空间，使预留空间不少于 headroom，且数据之后的可用空间不少于 tailroom
+		void Reallocate(std::size_t headroom, std::size_t tailroom);
+	};
+} // namespace YumeBot
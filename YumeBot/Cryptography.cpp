@@ -1,13 +1,31 @@
 #include "Cryptography.h"
 #include "Utility.h"
-#include <Cafe/Io/Streams/MemoryStream.h>
 #include <Cafe/Misc/Scope.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstring>
-#include <openssl/ecdh.h>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
 #include <openssl/md5.h>
 #include <openssl/objects.h>
 #include <random>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#	define YUMEBOT_CRYPTOGRAPHY_X86 1
+#	include <immintrin.h>
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#		define YUMEBOT_TARGET_SSE2
+#		define YUMEBOT_TARGET_AVX2
+#	else
+#		define YUMEBOT_TARGET_SSE2 __attribute__((target("sse2")))
+#		define YUMEBOT_TARGET_AVX2 __attribute__((target("avx2")))
+#	endif
+#else
+#	define YUMEBOT_CRYPTOGRAPHY_X86 0
+#endif
+
 #undef min
 #undef max
 
@@ -57,270 +75,1559 @@ namespace
 		output[0] = left;
 		output[1] = right;
 	}
-} // namespace
 
-std::array<std::uint32_t, 4> Tea::FormatKey(gsl::span<const std::byte> const& key)
-{
-	if (key.empty())
+	constexpr std::size_t ChaCha20BlockSize = 64;
+	constexpr std::size_t ChaCha20DoubleRoundTimes = 10;
+
+	constexpr void ChaCha20QuarterRound(std::uint32_t (&state)[16], std::size_t a, std::size_t b,
+	                                    std::size_t c, std::size_t d) noexcept
 	{
-		CAFE_THROW(CryptoException, u8"key is empty."_sv);
+		state[a] += state[b];
+		state[d] = std::rotl(state[d] ^ state[a], 16);
+		state[c] += state[d];
+		state[b] = std::rotl(state[b] ^ state[c], 12);
+		state[a] += state[b];
+		state[d] = std::rotl(state[d] ^ state[a], 8);
+		state[c] += state[d];
+		state[b] = std::rotl(state[b] ^ state[c], 7);
 	}
 
-	std::array<std::uint32_t, 4> result{ 0x20202020, 0x20202020, 0x20202020, 0x20202020 };
-	std::memcpy(result.data(), key.data(), std::min<std::size_t>(key.size(), 16));
-	return result;
-}
+	/// @brief  基于 ChaCha20 的随机数生成器，密钥及 nonce 于构造时从 std::random_device 取得
+	class ChaCha20Generator
+	{
+	public:
+		ChaCha20Generator()
+		{
+			// "expand 32-byte k"
+			m_State[0] = 0x61707865;
+			m_State[1] = 0x3320646E;
+			m_State[2] = 0x79622D32;
+			m_State[3] = 0x6B206574;
 
-std::size_t Tea::Encrypt(gsl::span<const std::byte> const& input,
-                         gsl::span<std::byte> const& output,
-                         gsl::span<const std::uint32_t, 4> const& key)
-{
-	Cafe::Io::ExternalMemoryOutputStream stream{ output, Cafe::Io::ErrorOnOutOfRange };
-	return Encrypt(input, &stream, key);
-}
+			std::random_device randomDevice;
+			for (std::size_t i = 4; i < 12; ++i)
+			{
+				m_State[i] = randomDevice();
+			}
+			m_State[12] = 0;
+			m_State[13] = 0;
+			m_State[14] = randomDevice();
+			m_State[15] = randomDevice();
+		}
 
-std::size_t Tea::Decrypt(gsl::span<const std::byte> const& input,
-                         gsl::span<std::byte> const& output,
-                         gsl::span<const std::uint32_t, 4> const& key)
-{
-	Cafe::Io::ExternalMemoryOutputStream stream{ output, Cafe::Io::ErrorOnOutOfRange };
-	return Decrypt(input, &stream, key);
-}
+		void Fill(std::byte* output, std::size_t size)
+		{
+			const auto bufferedSize = std::min(size, ChaCha20BlockSize - m_Position);
+			std::memcpy(output, m_Buffer + m_Position, bufferedSize);
+			m_Position += bufferedSize;
+			output += bufferedSize;
+			size -= bufferedSize;
 
-std::size_t Tea::Encrypt(gsl::span<const std::byte> const& input,
-                         Cafe::Io::OutputStream* outputStream,
-                         gsl::span<const std::uint32_t, 4> const& key)
-{
-	const auto totalProcessSize = CalculateOutputSize(input.size());
-	assert(totalProcessSize % TeaProcessUnitSize == 0);
+			// 大块的请求直接生成到 output 中
+			for (; size >= ChaCha20BlockSize; size -= ChaCha20BlockSize)
+			{
+				GenerateBlock(output);
+				output += ChaCha20BlockSize;
+			}
+
+			if (size)
+			{
+				GenerateBlock(m_Buffer);
+				std::memcpy(output, m_Buffer, size);
+				m_Position = size;
+			}
+		}
+
+	private:
+		std::uint32_t m_State[16];
+		std::byte m_Buffer[ChaCha20BlockSize];
+		std::size_t m_Position = ChaCha20BlockSize;
+
+		void GenerateBlock(std::byte* output) noexcept
+		{
+			std::uint32_t workingState[16];
+			std::memcpy(workingState, m_State, sizeof workingState);
 
-	const auto paddingSize = totalProcessSize - input.size();
-	const auto frontPaddingSize = paddingSize - 7;
+			for (std::size_t i = 0; i < ChaCha20DoubleRoundTimes; ++i)
+			{
+				ChaCha20QuarterRound(workingState, 0, 4, 8, 12);
+				ChaCha20QuarterRound(workingState, 1, 5, 9, 13);
+				ChaCha20QuarterRound(workingState, 2, 6, 10, 14);
+				ChaCha20QuarterRound(workingState, 3, 7, 11, 15);
+				ChaCha20QuarterRound(workingState, 0, 5, 10, 15);
+				ChaCha20QuarterRound(workingState, 1, 6, 11, 12);
+				ChaCha20QuarterRound(workingState, 2, 7, 8, 13);
+				ChaCha20QuarterRound(workingState, 3, 4, 9, 14);
+			}
 
-	std::random_device randomDevice;
-	std::default_random_engine randomEngine{ randomDevice() };
-	std::uniform_int_distribution<std::uint32_t> dist{ 0x00, 0xFF };
+			for (std::size_t i = 0; i < 16; ++i)
+			{
+				workingState[i] += m_State[i];
+			}
+			std::memcpy(output, workingState, ChaCha20BlockSize);
 
-	std::uint32_t inputBuffer[2];
-	std::uint32_t outputBuffer[2];
+			// 64 位的块计数器
+			if (!++m_State[12])
+			{
+				++m_State[13];
+			}
+		}
+	};
 
-	auto inputPtr = input.data();
+	ChaCha20Generator& GetThreadGenerator()
+	{
+		thread_local ChaCha20Generator generator;
+		return generator;
+	}
 
-	for (std::size_t processedLength = 0; processedLength < totalProcessSize;
-	     processedLength += TeaProcessUnitSize)
+	SimdLevel DetectSimdLevel() noexcept
 	{
-		if (processedLength == totalProcessSize - TeaProcessUnitSize)
+#if YUMEBOT_CRYPTOGRAPHY_X86
+#	ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		const auto maxLeaf = info[0];
+		__cpuid(info, 1);
+		if (!(info[3] & (1 << 26)))
 		{
-			reinterpret_cast<std::byte&>(inputBuffer[0]) = *inputPtr++;
-			std::memset(reinterpret_cast<std::byte*>(inputBuffer) + 1, 0, 7);
+			return SimdLevel::None;
 		}
-		else
-		{
-			auto writePointer = reinterpret_cast<std::byte*>(inputBuffer);
-			const auto writeEndPointer = reinterpret_cast<std::byte*>(std::end(inputBuffer));
 
-			if (processedLength < frontPaddingSize)
+		// 需要 OSXSAVE 及 AVX，且系统保存了 YMM 寄存器的状态
+		constexpr int OsxsaveAndAvx = (1 << 27) | (1 << 28);
+		if (maxLeaf >= 7 && (info[2] & OsxsaveAndAvx) == OsxsaveAndAvx && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
 			{
-				const auto paddingEndPointer =
-				    std::next(writePointer, std::min((sizeof inputBuffer) / sizeof(std::byte),
-				                                     frontPaddingSize - processedLength));
+				return SimdLevel::Avx2;
+			}
+		}
 
-				if (processedLength == 0)
-				{
-					*writePointer++ =
-					    static_cast<std::byte>((dist(randomEngine) & 0xF8) | (paddingSize - 10));
-				}
+		return SimdLevel::Sse2;
+#	else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return SimdLevel::Avx2;
+		}
+		if (__builtin_cpu_supports("sse2"))
+		{
+			return SimdLevel::Sse2;
+		}
+		return SimdLevel::None;
+#	endif
+#else
+		return SimdLevel::None;
+#endif
+	}
+
+	std::atomic<SimdLevel>& GetSimdLevelStorage() noexcept
+	{
+		static std::atomic<SimdLevel> level{ GetMaxSimdLevel() };
+		return level;
+	}
+
+	// 以下的 DecryptBlocks 均解密 input 起的 blockCount 个块，并与各自的前一个密文块异或后写入 output
+	// 调用者需保证 input 之前存在前一个密文块，且 input 与 output 不重叠
+
+	void DecryptBlocksScalar(const std::byte* input, std::byte* output, std::size_t blockCount,
+	                         gsl::span<const std::uint32_t, 4> const& key)
+	{
+		std::uint32_t inputBuffer[2];
+		std::uint32_t outputBuffer[2];
+		std::uint32_t lastInputBuffer[2];
+
+		for (std::size_t i = 0; i < blockCount; ++i)
+		{
+			const auto blockInput = input + i * TeaProcessUnitSize;
+			std::memcpy(inputBuffer, blockInput, TeaProcessUnitSize);
+			std::memcpy(lastInputBuffer, blockInput - TeaProcessUnitSize, TeaProcessUnitSize);
+
+			::Decrypt(inputBuffer, outputBuffer, key);
+			outputBuffer[0] ^= lastInputBuffer[0];
+			outputBuffer[1] ^= lastInputBuffer[1];
+
+			std::memcpy(output + i * TeaProcessUnitSize, outputBuffer, TeaProcessUnitSize);
+		}
+	}
+
+#if YUMEBOT_CRYPTOGRAPHY_X86
+	YUMEBOT_TARGET_SSE2 inline __m128i TeaMix(__m128i value, __m128i sum, __m128i k0, __m128i k1)
+	{
+		return _mm_xor_si128(
+		    _mm_xor_si128(_mm_add_epi32(_mm_slli_epi32(value, 4), k0), _mm_add_epi32(value, sum)),
+		    _mm_add_epi32(_mm_srli_epi32(value, 5), k1));
+	}
+
+	/// @brief  每次迭代处理 4 个块，各通道分别处理一个块
+	YUMEBOT_TARGET_SSE2 void DecryptBlocksSse2(const std::byte* input, std::byte* output,
+	                                           std::size_t blockCount,
+	                                           gsl::span<const std::uint32_t, 4> const& key)
+	{
+		constexpr std::size_t LaneCount = 4;
+
+		const auto a = _mm_set1_epi32(static_cast<int>(key[0]));
+		const auto b = _mm_set1_epi32(static_cast<int>(key[1]));
+		const auto c = _mm_set1_epi32(static_cast<int>(key[2]));
+		const auto d = _mm_set1_epi32(static_cast<int>(key[3]));
 
-				std::generate(writePointer, paddingEndPointer,
-				              [&] { return static_cast<std::byte>(dist(randomEngine)); });
+		std::size_t i = 0;
+		for (; i + LaneCount <= blockCount; i += LaneCount)
+		{
+			const auto blockInput = input + i * TeaProcessUnitSize;
+			const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blockInput));
+			const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blockInput + 16));
+
+			// { L0, R0, L1, R1 }, { L2, R2, L3, R3 } => { L0, L1, L2, L3 }, { R0, R1, R2, R3 }
+			auto left = _mm_castps_si128(_mm_shuffle_ps(
+			    _mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+			auto right = _mm_castps_si128(_mm_shuffle_ps(
+			    _mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
 
-				writePointer = paddingEndPointer;
+			auto sum = TeaDecryptInitSum;
+			for (std::size_t j = 0; j < TeaIterationTimes; ++j)
+			{
+				const auto sumVector = _mm_set1_epi32(static_cast<int>(sum));
+				right = _mm_sub_epi32(right, TeaMix(left, sumVector, c, d));
+				left = _mm_sub_epi32(left, TeaMix(right, sumVector, a, b));
+				sum -= TeaDelta;
 			}
 
-			const auto readSize = std::distance(writePointer, writeEndPointer);
-			std::memcpy(writePointer, inputPtr, readSize);
-			inputPtr += readSize;
+			const auto lastLow =
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(blockInput - TeaProcessUnitSize));
+			const auto lastHigh =
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(blockInput + 16 - TeaProcessUnitSize));
+
+			const auto blockOutput = output + i * TeaProcessUnitSize;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(blockOutput),
+			                 _mm_xor_si128(_mm_unpacklo_epi32(left, right), lastLow));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(blockOutput + 16),
+			                 _mm_xor_si128(_mm_unpackhi_epi32(left, right), lastHigh));
 		}
 
-		if (processedLength > 0)
+		DecryptBlocksScalar(input + i * TeaProcessUnitSize, output + i * TeaProcessUnitSize,
+		                    blockCount - i, key);
+	}
+
+	YUMEBOT_TARGET_AVX2 inline __m256i TeaMix(__m256i value, __m256i sum, __m256i k0, __m256i k1)
+	{
+		return _mm256_xor_si256(_mm256_xor_si256(_mm256_add_epi32(_mm256_slli_epi32(value, 4), k0),
+		                                         _mm256_add_epi32(value, sum)),
+		                        _mm256_add_epi32(_mm256_srli_epi32(value, 5), k1));
+	}
+
+	/// @brief  每次迭代处理 8 个块，各通道分别处理一个块
+	/// @remark _mm256_shuffle_ps 及 _mm256_unpack*_epi32 均在 128 位的半边内操作，
+	///         因此通道的顺序虽与块的顺序不同，但还原时恰好回到原来的顺序
+	YUMEBOT_TARGET_AVX2 void DecryptBlocksAvx2(const std::byte* input, std::byte* output,
+	                                           std::size_t blockCount,
+	                                           gsl::span<const std::uint32_t, 4> const& key)
+	{
+		constexpr std::size_t LaneCount = 8;
+
+		const auto a = _mm256_set1_epi32(static_cast<int>(key[0]));
+		const auto b = _mm256_set1_epi32(static_cast<int>(key[1]));
+		const auto c = _mm256_set1_epi32(static_cast<int>(key[2]));
+		const auto d = _mm256_set1_epi32(static_cast<int>(key[3]));
+
+		std::size_t i = 0;
+		for (; i + LaneCount <= blockCount; i += LaneCount)
 		{
-			const auto inputBytePtr = reinterpret_cast<std::byte*>(inputBuffer);
-			const auto outputBytePtr = reinterpret_cast<std::byte*>(outputBuffer);
-			for (std::size_t i = 0; i < (sizeof inputBuffer) / sizeof(std::byte); ++i)
+			const auto blockInput = input + i * TeaProcessUnitSize;
+			const auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blockInput));
+			const auto high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blockInput + 32));
+
+			auto left = _mm256_castps_si256(_mm256_shuffle_ps(
+			    _mm256_castsi256_ps(low), _mm256_castsi256_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+			auto right = _mm256_castps_si256(_mm256_shuffle_ps(
+			    _mm256_castsi256_ps(low), _mm256_castsi256_ps(high), _MM_SHUFFLE(3, 1, 3, 1)));
+
+			auto sum = TeaDecryptInitSum;
+			for (std::size_t j = 0; j < TeaIterationTimes; ++j)
 			{
-				inputBytePtr[i] ^= outputBytePtr[i];
+				const auto sumVector = _mm256_set1_epi32(static_cast<int>(sum));
+				right = _mm256_sub_epi32(right, TeaMix(left, sumVector, c, d));
+				left = _mm256_sub_epi32(left, TeaMix(right, sumVector, a, b));
+				sum -= TeaDelta;
 			}
+
+			const auto lastLow =
+			    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blockInput - TeaProcessUnitSize));
+			const auto lastHigh = _mm256_loadu_si256(
+			    reinterpret_cast<const __m256i*>(blockInput + 32 - TeaProcessUnitSize));
+
+			const auto blockOutput = output + i * TeaProcessUnitSize;
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(blockOutput),
+			                    _mm256_xor_si256(_mm256_unpacklo_epi32(left, right), lastLow));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(blockOutput + 32),
+			                    _mm256_xor_si256(_mm256_unpackhi_epi32(left, right), lastHigh));
 		}
 
-		::Encrypt(inputBuffer, outputBuffer, key);
-		outputStream->WriteBytes(gsl::as_bytes(gsl::make_span(outputBuffer)));
+		DecryptBlocksSse2(input + i * TeaProcessUnitSize, output + i * TeaProcessUnitSize,
+		                  blockCount - i, key);
 	}
+#endif
 
-	return totalProcessSize;
-}
+	/// @brief  批量加密时各个通道当前的块，以及各自的密钥，按通道分量存放以便直接载入向量寄存器
+	template <std::size_t LaneCount>
+	struct LaneBlocks
+	{
+		std::uint32_t Left[LaneCount];
+		std::uint32_t Right[LaneCount];
+		std::uint32_t Key[4][LaneCount];
+	};
 
-std::size_t Tea::Decrypt(gsl::span<const std::byte> const& input,
-                         Cafe::Io::OutputStream* outputStream,
-                         gsl::span<const std::uint32_t, 4> const& key)
-{
-	const auto inputSize = static_cast<std::size_t>(input.size());
-	if (inputSize % TeaProcessUnitSize != 0 || inputSize < 16)
+#if YUMEBOT_CRYPTOGRAPHY_X86
+	YUMEBOT_TARGET_SSE2 void EncryptLanesSse2(LaneBlocks<4>& blocks)
 	{
-		CAFE_THROW(CryptoException, u8"Invalid input data."_sv);
+		auto left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.Left));
+		auto right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.Right));
+		const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.Key[0]));
+		const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.Key[1]));
+		const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.Key[2]));
+		const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.Key[3]));
+
+		std::uint32_t sum = 0;
+		for (std::size_t i = 0; i < TeaIterationTimes; ++i)
+		{
+			sum += TeaDelta;
+			const auto sumVector = _mm_set1_epi32(static_cast<int>(sum));
+			left = _mm_add_epi32(left, TeaMix(right, sumVector, a, b));
+			right = _mm_add_epi32(right, TeaMix(left, sumVector, c, d));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(blocks.Left), left);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(blocks.Right), right);
 	}
 
-	std::uint32_t inputBuffer[2];
-	std::uint32_t outputBuffer[2];
-	std::uint32_t lastInputBuffer[2];
+	YUMEBOT_TARGET_AVX2 void EncryptLanesAvx2(LaneBlocks<8>& blocks)
+	{
+		auto left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.Left));
+		auto right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.Right));
+		const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.Key[0]));
+		const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.Key[1]));
+		const auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.Key[2]));
+		const auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.Key[3]));
+
+		std::uint32_t sum = 0;
+		for (std::size_t i = 0; i < TeaIterationTimes; ++i)
+		{
+			sum += TeaDelta;
+			const auto sumVector = _mm256_set1_epi32(static_cast<int>(sum));
+			left = _mm256_add_epi32(left, TeaMix(right, sumVector, a, b));
+			right = _mm256_add_epi32(right, TeaMix(left, sumVector, c, d));
+		}
 
-	std::size_t frontPaddingSize;
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks.Left), left);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks.Right), right);
+	}
+#endif
 
-	for (std::size_t processedLength = 0; processedLength < inputSize;
-	     processedLength += TeaProcessUnitSize)
+	/// @brief  写入随机的前部填充，首字节的低 3 位记录了填充的长度
+	void WriteFrontPadding(std::byte* output, std::size_t frontPaddingSize)
 	{
-		std::memcpy(inputBuffer, &input[processedLength], TeaProcessUnitSize);
+		GetThreadGenerator().Fill(output, frontPaddingSize);
+		output[0] = static_cast<std::byte>((static_cast<std::uint8_t>(output[0]) & 0xF8) |
+		                                   (frontPaddingSize - 3));
+	}
 
-		::Decrypt(inputBuffer, outputBuffer, key);
+	/// @brief  按 Tea::Encrypt 的格式在 output 中写入明文：随机的前部填充、input 及 7 个字节的 0
+	/// @remark input 可以与 output 重叠，以便就地加密
+	void WritePaddedPlaintext(gsl::span<const std::byte> const& input, std::byte* output)
+	{
+		const auto inputSize = static_cast<std::size_t>(input.size());
+		const auto frontPaddingSize = Tea::CalculateOutputSize(inputSize) - inputSize - 7;
 
-		if (processedLength > 0)
+		// 先移动 input，填充可能覆盖 input 原本所在的位置
+		if (inputSize)
 		{
-			const auto inputBytePtr = reinterpret_cast<std::byte*>(lastInputBuffer);
-			const auto outputBytePtr = reinterpret_cast<std::byte*>(outputBuffer);
-			for (std::size_t i = 0; i < (sizeof inputBuffer) / sizeof(std::byte); ++i)
-			{
-				outputBytePtr[i] ^= inputBytePtr[i];
-			}
+			std::memmove(output + frontPaddingSize, input.data(), inputSize);
 		}
+		std::memset(output + frontPaddingSize + inputSize, 0, 7);
+		WriteFrontPadding(output, frontPaddingSize);
+	}
 
-		std::memcpy(lastInputBuffer, inputBuffer, sizeof lastInputBuffer);
+	/// @brief  就地加密已写入明文的 output，块链中的每个块依赖前一个块的加密结果，只能串行处理
+	/// @param  lastBlock   前一个密文块，块链开始时应为 0，返回时为最后一个密文块
+	void EncryptChainInPlace(std::byte* output, std::size_t blockCount,
+	                         gsl::span<const std::uint32_t, 4> const& key,
+	                         std::uint32_t (&lastBlock)[2])
+	{
+		std::uint32_t buffer[2];
 
-		if (processedLength == 0)
+		for (std::size_t i = 0; i < blockCount; ++i)
 		{
-			const auto outputBufferPtr = reinterpret_cast<std::uint8_t*>(outputBuffer);
-			const std::size_t paddingSize = (outputBufferPtr[0] & 7u) + 10u;
-			frontPaddingSize = paddingSize - 7;
-			if (frontPaddingSize < TeaProcessUnitSize)
+			const auto block = output + i * TeaProcessUnitSize;
+			std::memcpy(buffer, block, TeaProcessUnitSize);
+			buffer[0] ^= lastBlock[0];
+			buffer[1] ^= lastBlock[1];
+			::Encrypt(buffer, lastBlock, key);
+			std::memcpy(block, lastBlock, TeaProcessUnitSize);
+		}
+	}
+
+	/// @brief  以 LaneCount 个通道交错地加密各个消息的块链
+	/// @remark 各个消息的明文应已写入对应的 Output 中
+	template <std::size_t LaneCount, void (*EncryptLanes)(LaneBlocks<LaneCount>&)>
+	void EncryptChainsInterleaved(gsl::span<const Tea::EncryptJob> const& jobs)
+	{
+		LaneBlocks<LaneCount> blocks;
+		std::byte* laneBlock[LaneCount]{};
+		std::size_t laneRemainBlockCount[LaneCount]{};
+		bool laneAtChainBegin[LaneCount]{};
+
+		auto nextJob = jobs.begin();
+		std::size_t activeLaneCount = 0;
+
+		const auto fillLane = [&](std::size_t lane) {
+			if (nextJob == jobs.end())
 			{
-				const auto dataSize = TeaProcessUnitSize - frontPaddingSize;
-				outputStream->WriteBytes(
-				    gsl::as_bytes(gsl::make_span(outputBufferPtr + frontPaddingSize, dataSize)));
+				return false;
 			}
-		}
-		else if (processedLength == inputSize - TeaProcessUnitSize)
+
+			const auto& job = *nextJob++;
+			laneBlock[lane] = job.Output.data();
+			laneRemainBlockCount[lane] =
+			    Tea::CalculateOutputSize(static_cast<std::size_t>(job.Input.size())) /
+			    TeaProcessUnitSize;
+			laneAtChainBegin[lane] = true;
+			for (std::size_t i = 0; i < 4; ++i)
+			{
+				blocks.Key[i][lane] = job.Key[i];
+			}
+			return true;
+		};
+
+		for (std::size_t lane = 0; lane < LaneCount; ++lane)
 		{
-			outputStream->WriteByte(reinterpret_cast<std::byte*>(outputBuffer)[0]);
+			if (fillLane(lane))
+			{
+				++activeLaneCount;
+			}
 		}
-		else
+
+		while (activeLaneCount)
 		{
-			if (processedLength + TeaProcessUnitSize <= frontPaddingSize)
+			for (std::size_t lane = 0; lane < LaneCount; ++lane)
 			{
-				continue;
+				if (!laneRemainBlockCount[lane])
+				{
+					continue;
+				}
+
+				std::uint32_t buffer[2];
+				std::memcpy(buffer, laneBlock[lane], TeaProcessUnitSize);
+				if (!laneAtChainBegin[lane])
+				{
+					std::uint32_t lastBuffer[2];
+					std::memcpy(lastBuffer, laneBlock[lane] - TeaProcessUnitSize, TeaProcessUnitSize);
+					buffer[0] ^= lastBuffer[0];
+					buffer[1] ^= lastBuffer[1];
+				}
+				blocks.Left[lane] = buffer[0];
+				blocks.Right[lane] = buffer[1];
 			}
 
-			auto outputSize = TeaProcessUnitSize;
-			auto outputBufferPtr = reinterpret_cast<std::byte*>(outputBuffer);
-			if (processedLength < frontPaddingSize)
+			// 空闲的通道仅计算无用的结果，不会被写回
+			EncryptLanes(blocks);
+
+			for (std::size_t lane = 0; lane < LaneCount; ++lane)
 			{
-				outputSize = processedLength + TeaProcessUnitSize - frontPaddingSize;
-				outputBufferPtr += TeaProcessUnitSize - outputSize;
-			}
+				if (!laneRemainBlockCount[lane])
+				{
+					continue;
+				}
+
+				const std::uint32_t buffer[2]{ blocks.Left[lane], blocks.Right[lane] };
+				std::memcpy(laneBlock[lane], buffer, TeaProcessUnitSize);
+				laneBlock[lane] += TeaProcessUnitSize;
+				laneAtChainBegin[lane] = false;
 
-			outputStream->WriteBytes(gsl::as_bytes(gsl::make_span(outputBufferPtr, outputSize)));
+				if (!--laneRemainBlockCount[lane] && !fillLane(lane))
+				{
+					--activeLaneCount;
+				}
+			}
 		}
 	}
 
-	return inputSize - frontPaddingSize - 7;
-}
-
-void Md5::Calculate(gsl::span<const std::byte> const& input, gsl::span<std::byte, 16> const& output)
-{
-	MD5(reinterpret_cast<const unsigned char*>(input.data()), input.size(),
-	    reinterpret_cast<unsigned char*>(output.data()));
-}
+	void DecryptBlocks(const std::byte* input, std::byte* output, std::size_t blockCount,
+	                   gsl::span<const std::uint32_t, 4> const& key)
+	{
+#if YUMEBOT_CRYPTOGRAPHY_X86
+		switch (GetSimdLevel())
+		{
+		case SimdLevel::Avx2:
+			DecryptBlocksAvx2(input, output, blockCount, key);
+			return;
+		case SimdLevel::Sse2:
+			DecryptBlocksSse2(input, output, blockCount, key);
+			return;
+		default:
+			break;
+		}
+#endif
+		DecryptBlocksScalar(input, output, blockCount, key);
+	}
 
-namespace
-{
-	// 对应 QQ 5.X
-	constexpr unsigned char S_PUB_KEY[] = { 0x04, 0x92, 0x8D, 0x88, 0x50, 0x67, 0x30, 0x88, 0xB3,
-		                                      0x43, 0x26, 0x4E, 0x0C, 0x6B, 0xAC, 0xB8, 0x49, 0x6D,
-		                                      0x69, 0x77, 0x99, 0xF3, 0x72, 0x11, 0xDE, 0xB2, 0x5B,
-		                                      0xB7, 0x39, 0x06, 0xCB, 0x08, 0x9F, 0xEA, 0x96, 0x39,
-		                                      0xB4, 0xE0, 0x26, 0x04, 0x98, 0xB5, 0x1A, 0x99, 0x2D,
-		                                      0x50, 0x81, 0x3D, 0xA8 };
-} // namespace
+	constexpr std::size_t TeaChunkSize = 64 * TeaProcessUnitSize;
 
-void Ecdh::GenerateKeyPair(gsl::span<std::byte, 25> const& pubKey,
-                           gsl::span<std::byte, 16> const& shareKey)
-{
-	const auto key = EC_KEY_new_by_curve_name(NID_secp192k1);
-	if (!key)
+	void CheckDecryptInputSize(std::size_t inputSize)
 	{
-		CAFE_THROW(CryptoException, u8"EC_KEY_new_by_curve_name failed"_sv);
+		if (inputSize % TeaProcessUnitSize != 0 || inputSize < 16)
+		{
+			CAFE_THROW(CryptoException, u8"Invalid input data."_sv);
+		}
 	}
 
-	CAFE_SCOPE_EXIT
+	/// @brief  解密首个块，并返回前部填充的长度
+	std::size_t DecryptFirstBlock(const std::byte* input, std::byte* output, std::size_t inputSize,
+	                              gsl::span<const std::uint32_t, 4> const& key)
 	{
-		EC_KEY_free(key);
-	};
+		std::uint32_t firstBlock[2];
+		std::memcpy(firstBlock, input, TeaProcessUnitSize);
+		::Decrypt(firstBlock, firstBlock, key);
+		std::memcpy(output, firstBlock, TeaProcessUnitSize);
 
-	if (!EC_KEY_generate_key(key))
-	{
-		CAFE_THROW(CryptoException, u8"EC_KEY_generate_key failed"_sv);
+		const std::size_t frontPaddingSize = (static_cast<std::uint8_t>(output[0]) & 7u) + 3u;
+		if (frontPaddingSize + 7 > inputSize)
+		{
+			CAFE_THROW(CryptoException, u8"Invalid input data."_sv);
+		}
+
+		return frontPaddingSize;
 	}
 
-	const auto point1 = EC_KEY_get0_public_key(key);
-	if (!point1)
+	/// @brief  分段解密到栈上的缓冲区，并将各分段中的数据部分及其在数据中的偏移传给 receiver
+	/// @remark 各个块的解密只依赖本块及前一块的密文，因此可以任意分段
+	template <typename Receiver>
+	std::size_t DecryptChunked(gsl::span<const std::byte> const& input,
+	                           gsl::span<const std::uint32_t, 4> const& key, Receiver&& receiver)
 	{
-		CAFE_THROW(CryptoException, u8"EC_KEY_get0_public_key failed"_sv);
+		const auto inputSize = static_cast<std::size_t>(input.size());
+		CheckDecryptInputSize(inputSize);
+
+		std::byte buffer[TeaChunkSize];
+		const auto inputPtr = input.data();
+		const auto frontPaddingSize = DecryptFirstBlock(inputPtr, buffer, inputSize, key);
+		// 末尾的 7 个字节为填充
+		const auto dataEnd = inputSize - 7;
+
+		for (std::size_t chunkBegin = 0; chunkBegin < inputSize; chunkBegin += TeaChunkSize)
+		{
+			const auto chunkSize = std::min(TeaChunkSize, inputSize - chunkBegin);
+			if (chunkBegin == 0)
+			{
+				DecryptBlocks(inputPtr + TeaProcessUnitSize, buffer + TeaProcessUnitSize,
+				              chunkSize / TeaProcessUnitSize - 1, key);
+			}
+			else
+			{
+				DecryptBlocks(inputPtr + chunkBegin, buffer, chunkSize / TeaProcessUnitSize, key);
+			}
+
+			const auto writeBegin = std::max(chunkBegin, frontPaddingSize);
+			const auto writeEnd = std::min(chunkBegin + chunkSize, dataEnd);
+			if (writeBegin < writeEnd)
+			{
+				receiver(writeBegin - frontPaddingSize, buffer + (writeBegin - chunkBegin),
+				         writeEnd - writeBegin);
+			}
+		}
+
+		return dataEnd - frontPaddingSize;
 	}
 
-	const auto group1 = EC_KEY_get0_group(key);
-	if (!group1)
+	constexpr std::size_t Md5BlockSize = 64;
+
+	constexpr std::uint32_t Md5InitState[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+
+	constexpr std::uint32_t Md5K[64] = {
+		0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613,
+		0xFD469501, 0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193,
+		0xA679438E, 0x49B40821, 0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D,
+		0x02441453, 0xD8A1E681, 0xE7D3FBC8, 0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED,
+		0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A, 0xFFFA3942, 0x8771F681, 0x6D9D6122,
+		0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70, 0x289B7EC6, 0xEAA127FA,
+		0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665, 0xF4292244,
+		0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+		0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB,
+		0xEB86D391
+	};
+
+	constexpr int Md5Shift[4][4] = { { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 },
+		                               { 6, 10, 15, 21 } };
+
+	/// @brief  批量计算 MD5 时各个通道的状态及当前块的各个字，按通道分量存放以便直接载入向量寄存器
+	template <std::size_t LaneCount>
+	struct Md5LaneBlocks
+	{
+		std::uint32_t State[4][LaneCount];
+		std::uint32_t Words[16][LaneCount];
+	};
+
+#if YUMEBOT_CRYPTOGRAPHY_X86
+	YUMEBOT_TARGET_SSE2 inline __m128i Md5Rotate(__m128i value, int shift)
 	{
-		CAFE_THROW(CryptoException, u8"EC_KEY_get0_group failed"_sv);
+		return _mm_or_si128(_mm_sll_epi32(value, _mm_cvtsi32_si128(shift)),
+		                    _mm_srl_epi32(value, _mm_cvtsi32_si128(32 - shift)));
 	}
 
-	unsigned char resultPubKey[25];
-	const auto octSize = EC_POINT_point2oct(group1, point1, POINT_CONVERSION_COMPRESSED, resultPubKey,
-	                                        sizeof resultPubKey, nullptr);
-	if (octSize != sizeof resultPubKey)
+	YUMEBOT_TARGET_SSE2 void Md5CompressSse2(Md5LaneBlocks<4>& blocks)
 	{
-		CAFE_THROW(CryptoException, u8"EC_POINT_point2oct failed"_sv);
+		__m128i words[16];
+		for (std::size_t i = 0; i < 16; ++i)
+		{
+			words[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.Words[i]));
+		}
+
+		const auto initA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.State[0]));
+		const auto initB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.State[1]));
+		const auto initC = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.State[2]));
+		const auto initD = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks.State[3]));
+		const auto allOnes = _mm_set1_epi32(-1);
+
+		auto a = initA, b = initB, c = initC, d = initD;
+		for (std::size_t i = 0; i < 64; ++i)
+		{
+			__m128i f;
+			std::size_t g;
+			switch (i / 16)
+			{
+			case 0:
+				f = _mm_or_si128(_mm_and_si128(b, c), _mm_andnot_si128(b, d));
+				g = i;
+				break;
+			case 1:
+				f = _mm_or_si128(_mm_and_si128(d, b), _mm_andnot_si128(d, c));
+				g = (5 * i + 1) % 16;
+				break;
+			case 2:
+				f = _mm_xor_si128(_mm_xor_si128(b, c), d);
+				g = (3 * i + 5) % 16;
+				break;
+			default:
+				f = _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, allOnes)));
+				g = (7 * i) % 16;
+				break;
+			}
+
+			f = _mm_add_epi32(_mm_add_epi32(f, a),
+			                  _mm_add_epi32(_mm_set1_epi32(static_cast<int>(Md5K[i])), words[g]));
+			a = d;
+			d = c;
+			c = b;
+			b = _mm_add_epi32(b, Md5Rotate(f, Md5Shift[i / 16][i % 4]));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(blocks.State[0]), _mm_add_epi32(a, initA));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(blocks.State[1]), _mm_add_epi32(b, initB));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(blocks.State[2]), _mm_add_epi32(c, initC));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(blocks.State[3]), _mm_add_epi32(d, initD));
 	}
 
-	const auto group2 = EC_KEY_get0_group(key);
-	if (!group2)
+	YUMEBOT_TARGET_AVX2 inline __m256i Md5Rotate(__m256i value, int shift)
 	{
-		CAFE_THROW(CryptoException, u8"EC_KEY_get0_group failed"_sv);
+		return _mm256_or_si256(_mm256_sll_epi32(value, _mm_cvtsi32_si128(shift)),
+		                       _mm256_srl_epi32(value, _mm_cvtsi32_si128(32 - shift)));
 	}
 
-	const auto point2 = EC_POINT_new(group2);
-	if (!point2)
+	YUMEBOT_TARGET_AVX2 void Md5CompressAvx2(Md5LaneBlocks<8>& blocks)
 	{
-		CAFE_THROW(CryptoException, u8"EC_POINT_new failed"_sv);
+		__m256i words[16];
+		for (std::size_t i = 0; i < 16; ++i)
+		{
+			words[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.Words[i]));
+		}
+
+		const auto initA = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.State[0]));
+		const auto initB = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.State[1]));
+		const auto initC = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.State[2]));
+		const auto initD = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks.State[3]));
+		const auto allOnes = _mm256_set1_epi32(-1);
+
+		auto a = initA, b = initB, c = initC, d = initD;
+		for (std::size_t i = 0; i < 64; ++i)
+		{
+			__m256i f;
+			std::size_t g;
+			switch (i / 16)
+			{
+			case 0:
+				f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_andnot_si256(b, d));
+				g = i;
+				break;
+			case 1:
+				f = _mm256_or_si256(_mm256_and_si256(d, b), _mm256_andnot_si256(d, c));
+				g = (5 * i + 1) % 16;
+				break;
+			case 2:
+				f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+				g = (3 * i + 5) % 16;
+				break;
+			default:
+				f = _mm256_xor_si256(c, _mm256_or_si256(b, _mm256_xor_si256(d, allOnes)));
+				g = (7 * i) % 16;
+				break;
+			}
+
+			f = _mm256_add_epi32(
+			    _mm256_add_epi32(f, a),
+			    _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(Md5K[i])), words[g]));
+			a = d;
+			d = c;
+			c = b;
+			b = _mm256_add_epi32(b, Md5Rotate(f, Md5Shift[i / 16][i % 4]));
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks.State[0]), _mm256_add_epi32(a, initA));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks.State[1]), _mm256_add_epi32(b, initB));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks.State[2]), _mm256_add_epi32(c, initC));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(blocks.State[3]), _mm256_add_epi32(d, initD));
 	}
 
-	CAFE_SCOPE_EXIT
+	/// @brief  批量计算中某个通道正在处理的消息
+	struct Md5LaneMessage
 	{
-		EC_POINT_free(point2);
+		const std::byte* Data;
+		/// @brief  Data 中剩余的完整块的数量
+		std::size_t FullBlockCount;
+		/// @brief  末尾不足一块的数据及填充，占 1 或 2 个块
+		std::byte Tail[Md5BlockSize * 2];
+		std::size_t TailBlockCount;
+		std::size_t TailBlockIndex;
+		std::array<std::byte, 16>* Output;
+
+		void Reset(gsl::span<const std::byte> const& input, std::array<std::byte, 16>* output)
+		{
+			const auto inputSize = static_cast<std::size_t>(input.size());
+			const auto tailSize = inputSize % Md5BlockSize;
+
+			Data = input.data();
+			FullBlockCount = inputSize / Md5BlockSize;
+			TailBlockCount = tailSize < Md5BlockSize - 8 ? 1 : 2;
+			TailBlockIndex = 0;
+			Output = output;
+
+			if (tailSize)
+			{
+				std::memcpy(Tail, Data + FullBlockCount * Md5BlockSize, tailSize);
+			}
+			Tail[tailSize] = std::byte{ 0x80 };
+			std::memset(Tail + tailSize + 1, 0, TailBlockCount * Md5BlockSize - tailSize - 1);
+
+			// 以位计算的长度，小端序
+			const auto bitLength = static_cast<std::uint64_t>(inputSize) * 8;
+			std::memcpy(Tail + TailBlockCount * Md5BlockSize - 8, &bitLength, sizeof bitLength);
+		}
+
+		bool IsFinished() const noexcept
+		{
+			return !FullBlockCount && TailBlockIndex == TailBlockCount;
+		}
+
+		const std::byte* NextBlock() noexcept
+		{
+			if (FullBlockCount)
+			{
+				--FullBlockCount;
+				return std::exchange(Data, Data + Md5BlockSize);
+			}
+			return Tail + Md5BlockSize * TailBlockIndex++;
+		}
 	};
 
-	const auto pointSize = EC_POINT_oct2point(group2, point2, S_PUB_KEY, sizeof S_PUB_KEY, nullptr);
-	if (!pointSize)
+	/// @brief  以 LaneCount 个通道交错地计算各个消息的 MD5
+	template <std::size_t LaneCount, void (*Md5Compress)(Md5LaneBlocks<LaneCount>&)>
+	void Md5Interleaved(gsl::span<const gsl::span<const std::byte>> const& inputs,
+	                    gsl::span<std::array<std::byte, 16>> const& outputs)
 	{
-		CAFE_THROW(CryptoException, u8"EC_POINT_oct2point failed"_sv);
-	}
+		Md5LaneBlocks<LaneCount> blocks;
+		Md5LaneMessage messages[LaneCount];
+		bool laneActive[LaneCount]{};
 
-	unsigned char resultShareKey[25];
-	const auto result = ECDH_compute_key(resultShareKey, sizeof resultShareKey, point2, key, nullptr);
-	if (result != sizeof resultShareKey)
-	{
-		CAFE_THROW(CryptoException, u8"ECDH_compute_key failed"_sv);
-	}
+		std::size_t nextMessage = 0;
+		std::size_t activeLaneCount = 0;
+		const auto messageCount = static_cast<std::size_t>(inputs.size());
 
-	unsigned char resultShareKeyMd5[16];
-	MD5(resultShareKey, result, resultShareKeyMd5);
+		const auto fillLane = [&](std::size_t lane) {
+			if (nextMessage == messageCount)
+			{
+				return laneActive[lane] = false;
+			}
+
+			messages[lane].Reset(inputs[nextMessage], &outputs[nextMessage]);
+			++nextMessage;
+			for (std::size_t i = 0; i < 4; ++i)
+			{
+				blocks.State[i][lane] = Md5InitState[i];
+			}
+			return laneActive[lane] = true;
+		};
+
+		for (std::size_t lane = 0; lane < LaneCount; ++lane)
+		{
+			if (fillLane(lane))
+			{
+				++activeLaneCount;
+			}
+		}
+
+		while (activeLaneCount)
+		{
+			for (std::size_t lane = 0; lane < LaneCount; ++lane)
+			{
+				if (!laneActive[lane])
+				{
+					continue;
+				}
+
+				const auto block = messages[lane].NextBlock();
+				for (std::size_t i = 0; i < 16; ++i)
+				{
+					std::memcpy(&blocks.Words[i][lane], block + i * 4, 4);
+				}
+			}
+
+			// 空闲的通道仅计算无用的结果，不会被写回
+			Md5Compress(blocks);
+
+			for (std::size_t lane = 0; lane < LaneCount; ++lane)
+			{
+				if (!laneActive[lane] || !messages[lane].IsFinished())
+				{
+					continue;
+				}
+
+				const auto output = messages[lane].Output->data();
+				for (std::size_t i = 0; i < 4; ++i)
+				{
+					std::memcpy(output + i * 4, &blocks.State[i][lane], 4);
+				}
+
+				if (!fillLane(lane))
+				{
+					--activeLaneCount;
+				}
+			}
+		}
+	}
+#endif
+} // namespace
+
+SimdLevel YumeBot::Cryptography::GetMaxSimdLevel() noexcept
+{
+	static const auto maxLevel = DetectSimdLevel();
+	return maxLevel;
+}
+
+SimdLevel YumeBot::Cryptography::GetSimdLevel() noexcept
+{
+	return GetSimdLevelStorage().load(std::memory_order_relaxed);
+}
+
+void YumeBot::Cryptography::SetSimdLevel(SimdLevel level) noexcept
+{
+	GetSimdLevelStorage().store(std::min(level, GetMaxSimdLevel()), std::memory_order_relaxed);
+}
+
+void Random::Fill(gsl::span<std::byte> const& output)
+{
+	GetThreadGenerator().Fill(output.data(), static_cast<std::size_t>(output.size()));
+}
+
+std::uint32_t Random::NextUInt32()
+{
+	std::uint32_t result;
+	GetThreadGenerator().Fill(reinterpret_cast<std::byte*>(&result), sizeof result);
+	return result;
+}
+
+std::array<std::uint32_t, 4> Tea::FormatKey(gsl::span<const std::byte> const& key)
+{
+	if (key.empty())
+	{
+		CAFE_THROW(CryptoException, u8"key is empty."_sv);
+	}
+
+	std::array<std::uint32_t, 4> result{ 0x20202020, 0x20202020, 0x20202020, 0x20202020 };
+	std::memcpy(result.data(), key.data(), std::min<std::size_t>(key.size(), 16));
+	return result;
+}
+
+Tea::TeaContext::TeaContext(gsl::span<const std::byte> const& key) : m_Key{ FormatKey(key) }
+{
+}
+
+Tea::TeaContext::TeaContext(gsl::span<const std::uint32_t, 4> const& formattedKey)
+{
+	std::copy(formattedKey.begin(), formattedKey.end(), m_Key.begin());
+}
+
+std::size_t Tea::TeaContext::Encrypt(gsl::span<const std::byte> const& input,
+                                     gsl::span<std::byte> const& output) const
+{
+	const auto outputSize = CalculateOutputSize(static_cast<std::size_t>(input.size()));
+	if (static_cast<std::size_t>(output.size()) < outputSize)
+	{
+		CAFE_THROW(CryptoException, u8"Output is not big enough."_sv);
+	}
+
+	WritePaddedPlaintext(input, output.data());
+	std::uint32_t lastBlock[2]{};
+	EncryptChainInPlace(output.data(), outputSize / TeaProcessUnitSize, m_Key, lastBlock);
+
+	return outputSize;
+}
+
+std::size_t Tea::TeaContext::Decrypt(gsl::span<const std::byte> const& input,
+                                     gsl::span<std::byte> const& output) const
+{
+	const auto outputSize = static_cast<std::size_t>(output.size());
+	return DecryptChunked(input, m_Key,
+	                      [&](std::size_t offset, const std::byte* data, std::size_t size) {
+		                      if (outputSize < offset + size)
+		                      {
+			                      CAFE_THROW(CryptoException, u8"Output is not big enough."_sv);
+		                      }
+		                      std::memcpy(output.data() + offset, data, size);
+	                      });
+}
+
+std::size_t Tea::TeaContext::EncryptInPlace(gsl::span<std::byte> const& buffer,
+                                            std::size_t inputSize) const
+{
+	const auto outputSize = CalculateOutputSize(inputSize);
+	if (static_cast<std::size_t>(buffer.size()) < outputSize)
+	{
+		CAFE_THROW(CryptoException, u8"Buffer is not big enough."_sv);
+	}
+
+	WritePaddedPlaintext(buffer.first(inputSize), buffer.data());
+	std::uint32_t lastBlock[2]{};
+	EncryptChainInPlace(buffer.data(), outputSize / TeaProcessUnitSize, m_Key, lastBlock);
+
+	return outputSize;
+}
+
+gsl::span<std::byte> Tea::TeaContext::DecryptInPlace(gsl::span<std::byte> const& buffer) const
+{
+	const auto bufferSize = static_cast<std::size_t>(buffer.size());
+	CheckDecryptInputSize(bufferSize);
+
+	const auto bufferPtr = buffer.data();
+	std::byte firstBlock[TeaProcessUnitSize];
+	const auto frontPaddingSize = DecryptFirstBlock(bufferPtr, firstBlock, bufferSize, m_Key);
+
+	// 从后向前分段解密，使得解密每个分段时，其前一个密文块尚未被覆盖
+	std::byte chunk[TeaChunkSize];
+	for (auto chunkEnd = bufferSize; chunkEnd > TeaProcessUnitSize;)
+	{
+		const auto chunkBegin =
+		    chunkEnd - std::min(TeaChunkSize, chunkEnd - TeaProcessUnitSize);
+		const auto chunkSize = chunkEnd - chunkBegin;
+		DecryptBlocks(bufferPtr + chunkBegin, chunk, chunkSize / TeaProcessUnitSize, m_Key);
+		std::memcpy(bufferPtr + chunkBegin, chunk, chunkSize);
+		chunkEnd = chunkBegin;
+	}
+	std::memcpy(bufferPtr, firstBlock, TeaProcessUnitSize);
+
+	return buffer.subspan(frontPaddingSize, bufferSize - 7 - frontPaddingSize);
+}
+
+Tea::DecryptStream::DecryptStream(gsl::span<const std::byte> const& input,
+                                  TeaContext const& context)
+    : m_Input{ input }, m_Context{ context }, m_Position{}, m_ChunkIndex{}
+{
+	const auto inputSize = static_cast<std::size_t>(input.size());
+	CheckDecryptInputSize(inputSize);
+
+	// 首个分段总会被读取，因此直接解密
+	const auto firstChunkSize = std::min(ChunkSize, inputSize);
+	m_FrontPaddingSize = DecryptFirstBlock(input.data(), m_Chunk, inputSize, m_Context.GetKey());
+	DecryptBlocks(input.data() + TeaProcessUnitSize, m_Chunk + TeaProcessUnitSize,
+	              firstChunkSize / TeaProcessUnitSize - 1, m_Context.GetKey());
+	m_DataSize = inputSize - 7 - m_FrontPaddingSize;
+}
+
+std::size_t Tea::DecryptStream::GetAvailableBytes()
+{
+	return m_DataSize - m_Position;
+}
+
+std::optional<std::byte> Tea::DecryptStream::ReadByte()
+{
+	if (m_Position >= m_DataSize)
+	{
+		return {};
+	}
+
+	const auto offset = LoadChunk();
+	++m_Position;
+	return m_Chunk[offset];
+}
+
+std::size_t Tea::DecryptStream::ReadBytes(gsl::span<std::byte> const& buffer)
+{
+	const auto readSize =
+	    std::min(static_cast<std::size_t>(buffer.size()), m_DataSize - m_Position);
+
+	for (std::size_t copiedSize = 0; copiedSize < readSize;)
+	{
+		const auto offset = LoadChunk();
+		const auto copySize = std::min(readSize - copiedSize, ChunkSize - offset);
+		std::memcpy(buffer.data() + copiedSize, m_Chunk + offset, copySize);
+		copiedSize += copySize;
+		m_Position += copySize;
+	}
+
+	return readSize;
+}
+
+std::size_t Tea::DecryptStream::Skip(std::size_t n)
+{
+	// 跳过的部分不需要解密
+	const auto skipSize = std::min(n, m_DataSize - m_Position);
+	m_Position += skipSize;
+	return skipSize;
+}
+
+std::size_t Tea::DecryptStream::GetTotalSize()
+{
+	return m_DataSize;
+}
+
+std::size_t Tea::DecryptStream::GetPosition() const
+{
+	return m_Position;
+}
+
+void Tea::DecryptStream::SeekFromBegin(std::size_t pos)
+{
+	if (pos > m_DataSize)
+	{
+		CAFE_THROW(CryptoException, u8"Position out of range."_sv);
+	}
+
+	m_Position = pos;
+}
+
+void Tea::DecryptStream::Seek(Cafe::Io::SeekOrigin origin, std::ptrdiff_t diff)
+{
+	std::size_t base;
+	switch (origin)
+	{
+	case Cafe::Io::SeekOrigin::Begin:
+		base = 0;
+		break;
+	case Cafe::Io::SeekOrigin::Current:
+		base = m_Position;
+		break;
+	case Cafe::Io::SeekOrigin::End:
+		base = m_DataSize;
+		break;
+	default:
+		CAFE_THROW(CryptoException, u8"Invalid origin."_sv);
+	}
+
+	if (diff < 0 && static_cast<std::size_t>(-diff) > base)
+	{
+		CAFE_THROW(CryptoException, u8"Position out of range."_sv);
+	}
+
+	SeekFromBegin(base + diff);
+}
+
+std::size_t Tea::DecryptStream::LoadChunk()
+{
+	const auto inputPosition = m_FrontPaddingSize + m_Position;
+	const auto chunkIndex = inputPosition / ChunkSize;
+	const auto chunkBegin = chunkIndex * ChunkSize;
+
+	if (chunkIndex != m_ChunkIndex)
+	{
+		const auto inputSize = static_cast<std::size_t>(m_Input.size());
+		const auto chunkSize = std::min(ChunkSize, inputSize - chunkBegin);
+
+		// 首个块不与前一个块异或，需单独处理
+		if (chunkIndex == 0)
+		{
+			DecryptFirstBlock(m_Input.data(), m_Chunk, inputSize, m_Context.GetKey());
+			DecryptBlocks(m_Input.data() + TeaProcessUnitSize, m_Chunk + TeaProcessUnitSize,
+			              chunkSize / TeaProcessUnitSize - 1, m_Context.GetKey());
+		}
+		else
+		{
+			DecryptBlocks(m_Input.data() + chunkBegin, m_Chunk, chunkSize / TeaProcessUnitSize,
+			              m_Context.GetKey());
+		}
+
+		m_ChunkIndex = chunkIndex;
+	}
+
+	return inputPosition - chunkBegin;
+}
+
+std::size_t Tea::Encrypt(gsl::span<const std::byte> const& input,
+                         gsl::span<std::byte> const& output,
+                         gsl::span<const std::uint32_t, 4> const& key)
+{
+	return TeaContext{ key }.Encrypt(input, output);
+}
+
+std::size_t Tea::Decrypt(gsl::span<const std::byte> const& input,
+                         gsl::span<std::byte> const& output,
+                         gsl::span<const std::uint32_t, 4> const& key)
+{
+	return TeaContext{ key }.Decrypt(input, output);
+}
+
+std::size_t Tea::Encrypt(gsl::span<const std::byte> const& input,
+                         Cafe::Io::OutputStream* outputStream,
+                         gsl::span<const std::uint32_t, 4> const& key)
+{
+	const auto inputSize = static_cast<std::size_t>(input.size());
+	const auto totalSize = CalculateOutputSize(inputSize);
+	const auto frontPaddingSize = totalSize - inputSize - 7;
+
+	// 分段写入明文并加密，块链的状态在分段间延续
+	std::byte buffer[TeaChunkSize];
+	std::uint32_t lastBlock[2]{};
+	std::size_t inputOffset = 0;
+
+	for (std::size_t chunkBegin = 0; chunkBegin < totalSize; chunkBegin += TeaChunkSize)
+	{
+		const auto chunkSize = std::min(TeaChunkSize, totalSize - chunkBegin);
+
+		std::size_t position = 0;
+		if (chunkBegin == 0)
+		{
+			WriteFrontPadding(buffer, frontPaddingSize);
+			position = frontPaddingSize;
+		}
+
+		const auto copySize = std::min(chunkSize - position, inputSize - inputOffset);
+		if (copySize)
+		{
+			std::memcpy(buffer + position, input.data() + inputOffset, copySize);
+			inputOffset += copySize;
+			position += copySize;
+		}
+		std::memset(buffer + position, 0, chunkSize - position);
+
+		EncryptChainInPlace(buffer, chunkSize / TeaProcessUnitSize, key, lastBlock);
+		outputStream->WriteBytes(gsl::make_span(buffer, chunkSize));
+	}
+
+	return totalSize;
+}
+
+std::size_t Tea::Decrypt(gsl::span<const std::byte> const& input,
+                         Cafe::Io::OutputStream* outputStream,
+                         gsl::span<const std::uint32_t, 4> const& key)
+{
+	return DecryptChunked(input, key, [&](std::size_t, const std::byte* data, std::size_t size) {
+		outputStream->WriteBytes(gsl::make_span(data, size));
+	});
+}
+
+void Tea::EncryptBatch(gsl::span<const EncryptJob> const& jobs)
+{
+	for (const auto& job : jobs)
+	{
+		if (static_cast<std::size_t>(job.Output.size()) <
+		    CalculateOutputSize(static_cast<std::size_t>(job.Input.size())))
+		{
+			CAFE_THROW(CryptoException, u8"Output is not big enough."_sv);
+		}
+	}
+
+	for (const auto& job : jobs)
+	{
+		WritePaddedPlaintext(job.Input, job.Output.data());
+	}
+
+#if YUMEBOT_CRYPTOGRAPHY_X86
+	// 消息数量不足时大部分通道空闲，不如直接串行加密
+	switch (GetSimdLevel())
+	{
+	case SimdLevel::Avx2:
+		if (jobs.size() > 4)
+		{
+			EncryptChainsInterleaved<8, EncryptLanesAvx2>(jobs);
+			return;
+		}
+		[[fallthrough]];
+	case SimdLevel::Sse2:
+		if (jobs.size() > 1)
+		{
+			EncryptChainsInterleaved<4, EncryptLanesSse2>(jobs);
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+#endif
+
+	for (const auto& job : jobs)
+	{
+		std::uint32_t lastBlock[2]{};
+		EncryptChainInPlace(job.Output.data(),
+		                    CalculateOutputSize(static_cast<std::size_t>(job.Input.size())) /
+		                        TeaProcessUnitSize,
+		                    job.Key, lastBlock);
+	}
+}
+
+void Md5::Calculate(gsl::span<const std::byte> const& input, gsl::span<std::byte, 16> const& output)
+{
+	MD5(reinterpret_cast<const unsigned char*>(input.data()), input.size(),
+	    reinterpret_cast<unsigned char*>(output.data()));
+}
+
+static_assert(sizeof(MD5_CTX) <= sizeof(Md5::Context) && alignof(MD5_CTX) <= alignof(Md5::Context),
+              "Storage of Md5::Context is not enough for MD5_CTX.");
+
+Md5::Context::Context() noexcept
+{
+	MD5_Init(reinterpret_cast<MD5_CTX*>(m_State));
+}
+
+void Md5::Context::Update(gsl::span<const std::byte> const& input) noexcept
+{
+	MD5_Update(reinterpret_cast<MD5_CTX*>(m_State), input.data(),
+	           static_cast<std::size_t>(input.size()));
+}
+
+void Md5::Context::Final(gsl::span<std::byte, 16> const& output) noexcept
+{
+	const auto context = reinterpret_cast<MD5_CTX*>(m_State);
+	MD5_Final(reinterpret_cast<unsigned char*>(output.data()), context);
+	MD5_Init(context);
+}
+
+void Md5::CalculateBatch(gsl::span<const gsl::span<const std::byte>> const& inputs,
+                         gsl::span<std::array<std::byte, 16>> const& outputs)
+{
+	if (inputs.size() != outputs.size())
+	{
+		CAFE_THROW(CryptoException, u8"Size of inputs and outputs mismatch."_sv);
+	}
+
+#if YUMEBOT_CRYPTOGRAPHY_X86
+	// 消息数量不足时大部分通道空闲，不如直接逐个计算
+	switch (GetSimdLevel())
+	{
+	case SimdLevel::Avx2:
+		if (inputs.size() > 4)
+		{
+			Md5Interleaved<8, Md5CompressAvx2>(inputs, outputs);
+			return;
+		}
+		[[fallthrough]];
+	case SimdLevel::Sse2:
+		if (inputs.size() > 1)
+		{
+			Md5Interleaved<4, Md5CompressSse2>(inputs, outputs);
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+#endif
+
+	for (std::ptrdiff_t i = 0; i < inputs.size(); ++i)
+	{
+		Calculate(inputs[i], outputs[i]);
+	}
+}
+
+namespace
+{
+	// 对应 QQ 5.X
+	constexpr unsigned char S_PUB_KEY[] = { 0x04, 0x92, 0x8D, 0x88, 0x50, 0x67, 0x30, 0x88, 0xB3,
+		                                      0x43, 0x26, 0x4E, 0x0C, 0x6B, 0xAC, 0xB8, 0x49, 0x6D,
+		                                      0x69, 0x77, 0x99, 0xF3, 0x72, 0x11, 0xDE, 0xB2, 0x5B,
+		                                      0xB7, 0x39, 0x06, 0xCB, 0x08, 0x9F, 0xEA, 0x96, 0x39,
+		                                      0xB4, 0xE0, 0x26, 0x04, 0x98, 0xB5, 0x1A, 0x99, 0x2D,
+		                                      0x50, 0x81, 0x3D, 0xA8 };
+
+	/// @brief  预先准备的曲线及服务器的公钥，准备后只读，可在多个线程间共享
+	class EcdhServerContext
+	{
+	public:
+		EcdhServerContext()
+		{
+			m_Group = EC_GROUP_new_by_curve_name(NID_secp192k1);
+			if (!m_Group)
+			{
+				CAFE_THROW(CryptoException, u8"EC_GROUP_new_by_curve_name failed"_sv);
+			}
+
+			auto succeed = false;
+			CAFE_SCOPE_EXIT
+			{
+				if (!succeed)
+				{
+					EC_POINT_free(m_ServerPoint);
+					EC_GROUP_free(m_Group);
+				}
+			};
+
+			m_ServerPoint = EC_POINT_new(m_Group);
+			if (!m_ServerPoint)
+			{
+				CAFE_THROW(CryptoException, u8"EC_POINT_new failed"_sv);
+			}
+
+			if (!EC_POINT_oct2point(m_Group, m_ServerPoint, S_PUB_KEY, sizeof S_PUB_KEY, nullptr))
+			{
+				CAFE_THROW(CryptoException, u8"EC_POINT_oct2point failed"_sv);
+			}
+
+			succeed = true;
+		}
+
+		EcdhServerContext(EcdhServerContext const&) = delete;
+		EcdhServerContext& operator=(EcdhServerContext const&) = delete;
+
+		~EcdhServerContext()
+		{
+			EC_POINT_free(m_ServerPoint);
+			EC_GROUP_free(m_Group);
+		}
+
+		/// @remark 共享密钥为双方公钥相乘所得点的 x 坐标的 MD5
+		void GenerateKeyPair(BN_CTX* bnContext, gsl::span<std::byte, 25> const& pubKey,
+		                     gsl::span<std::byte, 16> const& shareKey) const
+		{
+			BN_CTX_start(bnContext);
+			CAFE_SCOPE_EXIT
+			{
+				BN_CTX_end(bnContext);
+			};
+
+			const auto privateKey = BN_CTX_get(bnContext);
+			const auto shareX = BN_CTX_get(bnContext);
+			if (!shareX)
+			{
+				CAFE_THROW(CryptoException, u8"BN_CTX_get failed"_sv);
+			}
+
+			// 私钥的取值范围为 [1, order)
+			do
+			{
+				if (!BN_priv_rand_range(privateKey, EC_GROUP_get0_order(m_Group)))
+				{
+					CAFE_THROW(CryptoException, u8"BN_priv_rand_range failed"_sv);
+				}
+			} while (BN_is_zero(privateKey));
+
+			const auto point = EC_POINT_new(m_Group);
+			if (!point)
+			{
+				CAFE_THROW(CryptoException, u8"EC_POINT_new failed"_sv);
+			}
+
+			CAFE_SCOPE_EXIT
+			{
+				EC_POINT_clear_free(point);
+			};
+
+			if (!EC_POINT_mul(m_Group, point, privateKey, nullptr, nullptr, bnContext))
+			{
+				CAFE_THROW(CryptoException, u8"EC_POINT_mul failed"_sv);
+			}
+
+			unsigned char resultPubKey[25];
+			const auto octSize = EC_POINT_point2oct(m_Group, point, POINT_CONVERSION_COMPRESSED,
+			                                        resultPubKey, sizeof resultPubKey, bnContext);
+			if (octSize != sizeof resultPubKey)
+			{
+				CAFE_THROW(CryptoException, u8"EC_POINT_point2oct failed"_sv);
+			}
+
+			if (!EC_POINT_mul(m_Group, point, nullptr, m_ServerPoint, privateKey, bnContext))
+			{
+				CAFE_THROW(CryptoException, u8"EC_POINT_mul failed"_sv);
+			}
+
+			if (!EC_POINT_get_affine_coordinates(m_Group, point, shareX, nullptr, bnContext))
+			{
+				CAFE_THROW(CryptoException, u8"EC_POINT_get_affine_coordinates failed"_sv);
+			}
+
+			unsigned char resultShareKey[24];
+			if (BN_bn2binpad(shareX, resultShareKey, sizeof resultShareKey) != sizeof resultShareKey)
+			{
+				CAFE_THROW(CryptoException, u8"BN_bn2binpad failed"_sv);
+			}
+
+			std::memcpy(pubKey.data(), resultPubKey, sizeof resultPubKey);
+			MD5(resultShareKey, sizeof resultShareKey, reinterpret_cast<unsigned char*>(shareKey.data()));
+		}
+
+	private:
+		EC_GROUP* m_Group;
+		EC_POINT* m_ServerPoint{};
+	};
+
+	EcdhServerContext const& GetEcdhServerContext()
+	{
+		static const EcdhServerContext context;
+		return context;
+	}
+
+	/// @brief  BN_CTX 的 RAII 包装
+	class BnContext
+	{
+	public:
+		BnContext() : m_Context{ BN_CTX_new() }
+		{
+			if (!m_Context)
+			{
+				CAFE_THROW(CryptoException, u8"BN_CTX_new failed"_sv);
+			}
+		}
+
+		BnContext(BnContext const&) = delete;
+		BnContext& operator=(BnContext const&) = delete;
+
+		~BnContext()
+		{
+			BN_CTX_free(m_Context);
+		}
+
+		BN_CTX* Get() const noexcept
+		{
+			return m_Context;
+		}
+
+	private:
+		BN_CTX* m_Context;
+	};
+
+	std::atomic<Ecdh::KeyPairPool*> GlobalKeyPairPool{};
+} // namespace
+
+void Ecdh::GenerateKeyPair(gsl::span<std::byte, 25> const& pubKey,
+                           gsl::span<std::byte, 16> const& shareKey)
+{
+	const BnContext bnContext;
+	GetEcdhServerContext().GenerateKeyPair(bnContext.Get(), pubKey, shareKey);
+}
+
+Ecdh::KeyPair Ecdh::GenerateKeyPair()
+{
+	KeyPair result;
+	GenerateKeyPair(result.PubKey, result.ShareKey);
+	return result;
+}
+
+void Ecdh::GenerateKeyPairs(gsl::span<KeyPair> const& keyPairs)
+{
+	const auto& serverContext = GetEcdhServerContext();
+	const BnContext bnContext;
+	for (auto& keyPair : keyPairs)
+	{
+		serverContext.GenerateKeyPair(bnContext.Get(), keyPair.PubKey, keyPair.ShareKey);
+	}
+}
+
+Ecdh::KeyPairPool::KeyPairPool(std::size_t capacity, std::size_t lowWatermark)
+    : m_Capacity{ std::max(capacity, std::size_t{ 1 }) },
+      m_LowWatermark{ std::clamp(lowWatermark, std::size_t{ 1 }, m_Capacity) }, m_Stopping{ false }
+{
+	m_KeyPairs.reserve(m_Capacity);
+	m_RefillThread = std::thread{ &KeyPairPool::RefillThreadMain, this };
+}
+
+Ecdh::KeyPairPool::~KeyPairPool()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_Stopping = true;
+	}
+	m_RefillCondition.notify_all();
+	m_RefillThread.join();
+}
+
+Ecdh::KeyPair Ecdh::KeyPairPool::Acquire()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		if (m_RefillError)
+		{
+			std::rethrow_exception(m_RefillError);
+		}
+
+		if (!m_KeyPairs.empty())
+		{
+			const auto result = m_KeyPairs.back();
+			m_KeyPairs.pop_back();
+			if (m_KeyPairs.size() < m_LowWatermark)
+			{
+				m_RefillCondition.notify_one();
+			}
+			return result;
+		}
+	}
+
+	return GenerateKeyPair();
+}
+
+std::size_t Ecdh::KeyPairPool::GetAvailableCount() const
+{
+	std::lock_guard lock{ m_Mutex };
+	return m_KeyPairs.size();
+}
+
+void Ecdh::KeyPairPool::RefillThreadMain()
+try
+{
+	const auto& serverContext = GetEcdhServerContext();
+	const BnContext bnContext;
+
+	std::unique_lock lock{ m_Mutex };
+	while (true)
+	{
+		m_RefillCondition.wait(lock,
+		                       [&] { return m_Stopping || m_KeyPairs.size() < m_LowWatermark; });
+
+		while (!m_Stopping && m_KeyPairs.size() < m_Capacity)
+		{
+			// 生成时不持有锁，以免阻塞 Acquire
+			lock.unlock();
+			KeyPair keyPair;
+			serverContext.GenerateKeyPair(bnContext.Get(), keyPair.PubKey, keyPair.ShareKey);
+			lock.lock();
+			m_KeyPairs.emplace_back(keyPair);
+		}
+
+		if (m_Stopping)
+		{
+			return;
+		}
+	}
+}
+catch (...)
+{
+	// 此时已离开 try 块，锁已释放
+	std::lock_guard lock{ m_Mutex };
+	m_RefillError = std::current_exception();
+}
+
+void Ecdh::SetGlobalKeyPairPool(KeyPairPool* pool) noexcept
+{
+	GlobalKeyPairPool.store(pool, std::memory_order_release);
+}
+
+Ecdh::KeyPair Ecdh::AcquireKeyPair()
+{
+	const auto pool = GlobalKeyPairPool.load(std::memory_order_acquire);
+	return pool ? pool->Acquire() : GenerateKeyPair();
+}
 
-	std::memcpy(pubKey.data(), resultPubKey, 25);
-	std::memcpy(shareKey.data(), resultShareKeyMd5, 16);
-}
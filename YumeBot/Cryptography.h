@@ -4,12 +4,47 @@
 #include <Cafe/Io/Streams/StreamBase.h>
 
 #include "Utility.h"
+#include <array>
 #include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 
 namespace YumeBot::Cryptography
 {
 	CAFE_DEFINE_GENERAL_EXCEPTION(CryptoException);
 
+	/// @brief  加解密时使用的 SIMD 指令集
+	enum class SimdLevel
+	{
+		None,
+		Sse2,
+		Avx2,
+	};
+
+	/// @brief  获得当前 CPU 及系统所支持的最高级别
+	SimdLevel GetMaxSimdLevel() noexcept;
+
+	/// @brief  获得当前使用的级别，默认为 GetMaxSimdLevel()
+	SimdLevel GetSimdLevel() noexcept;
+
+	/// @brief  设置使用的级别，主要用于测试及性能比较
+	/// @remark 超过 GetMaxSimdLevel() 的级别将被限制为 GetMaxSimdLevel()
+	void SetSimdLevel(SimdLevel level) noexcept;
+
+	namespace Random
+	{
+		/// @brief  以当前线程的生成器填充 output
+		/// @remark 每个线程使用独立的基于 ChaCha20 的生成器，仅在线程内首次使用时从 std::random_device
+		///         取得种子，之后的调用不再访问系统
+		void Fill(gsl::span<std::byte> const& output);
+
+		std::uint32_t NextUInt32();
+	} // namespace Random
+
 	namespace Tea
 	{
 		constexpr std::size_t TeaProcessUnitSize = 8;
@@ -21,11 +56,82 @@ namespace YumeBot::Cryptography
 
 		std::array<std::uint32_t, 4> FormatKey(gsl::span<const std::byte> const& key);
 
+		/// @brief  持有已格式化的密钥，可在多个消息间复用，直接在内存间加解密
+		class TeaContext
+		{
+		public:
+			/// @brief  以未格式化的密钥构造，等价于使用 FormatKey(key) 的结果构造
+			explicit TeaContext(gsl::span<const std::byte> const& key);
+			explicit TeaContext(gsl::span<const std::uint32_t, 4> const& formattedKey);
+
+			gsl::span<const std::uint32_t, 4> GetKey() const noexcept
+			{
+				return m_Key;
+			}
+
+			/// @brief  加密 input 到 output，output 的大小应不小于 CalculateOutputSize(input.size())
+			/// @return 写入的字节数
+			std::size_t Encrypt(gsl::span<const std::byte> const& input,
+			                    gsl::span<std::byte> const& output) const;
+			/// @brief  解密 input 到 output
+			/// @return 写入的字节数
+			std::size_t Decrypt(gsl::span<const std::byte> const& input,
+			                    gsl::span<std::byte> const& output) const;
+
+			/// @brief  就地加密 buffer 的前 inputSize 个字节
+			/// @remark buffer 的大小应不小于 CalculateOutputSize(inputSize)
+			/// @return 密文的大小，密文自 buffer 的起始处开始
+			std::size_t EncryptInPlace(gsl::span<std::byte> const& buffer, std::size_t inputSize) const;
+			/// @brief  就地解密 buffer
+			/// @return 明文在 buffer 中的范围
+			gsl::span<std::byte> DecryptInPlace(gsl::span<std::byte> const& buffer) const;
+
+		private:
+			std::array<std::uint32_t, 4> m_Key;
+		};
+
 		std::size_t Encrypt(gsl::span<const std::byte> const& input, gsl::span<std::byte> const& output,
 		                    gsl::span<const std::uint32_t, 4> const& key);
 		std::size_t Decrypt(gsl::span<const std::byte> const& input, gsl::span<std::byte> const& output,
 		                    gsl::span<const std::uint32_t, 4> const& key);
 
+		/// @brief  按需解密的只读流，可将密文直接交给 TlvReader 或 JceInputStream 解析
+		/// @remark 仅解密当前位置所在的分段到内部的缓冲区中，不会产生完整的明文副本
+		///         定位到其他分段时将重新解密该分段，因此顺序读取时每个块只解密一次
+		///         input 应在流的生命周期内保持有效
+		class DecryptStream : public Cafe::Io::InputStream, public Cafe::Io::SeekableStreamBase
+		{
+		public:
+			/// @brief  分段的大小，应能放入 L1 缓存中
+			static constexpr std::size_t ChunkSize = 4096;
+
+			DecryptStream(gsl::span<const std::byte> const& input, TeaContext const& context);
+
+			std::size_t GetAvailableBytes() override;
+			std::optional<std::byte> ReadByte() override;
+			std::size_t ReadBytes(gsl::span<std::byte> const& buffer) override;
+			std::size_t Skip(std::size_t n) override;
+
+			std::size_t GetTotalSize() override;
+			std::size_t GetPosition() const override;
+			void SeekFromBegin(std::size_t pos) override;
+			void Seek(Cafe::Io::SeekOrigin origin, std::ptrdiff_t diff) override;
+
+		private:
+			gsl::span<const std::byte> m_Input;
+			TeaContext m_Context;
+			std::size_t m_FrontPaddingSize;
+			std::size_t m_DataSize;
+			/// @brief  以明文的数据部分计算的位置
+			std::size_t m_Position;
+			/// @brief  已解密的分段在密文中的序号
+			std::size_t m_ChunkIndex;
+			std::byte m_Chunk[ChunkSize];
+
+			/// @brief  确保当前位置所在的分段已解密，并返回当前位置在分段中的偏移
+			std::size_t LoadChunk();
+		};
+
 		///	@see    https://baike.baidu.com/item/TEA%E5%8A%A0%E5%AF%86%E7%AE%97%E6%B3%95
 		/// @return 应当写入的字节数，用户应检查是否成功写入指定数量的字节到 outputStream 内
 		///         若 outputStream 在写入开始前具有不少于 Tea::CalculateOutputSize(key.size())
@@ -36,12 +142,49 @@ namespace YumeBot::Cryptography
 		std::size_t Decrypt(gsl::span<const std::byte> const& input,
 		                    Cafe::Io::OutputStream* outputStream,
 		                    gsl::span<const std::uint32_t, 4> const& key);
+
+		/// @brief  批量加密中的一个消息
+		struct EncryptJob
+		{
+			gsl::span<const std::byte> Input;
+			/// @brief  大小应不小于 CalculateOutputSize(Input.size())，且不应与 Input 重叠
+			gsl::span<std::byte> Output;
+			std::array<std::uint32_t, 4> Key;
+		};
+
+		/// @brief  加密多个互相独立的消息，每个消息的结果与单独调用 Encrypt 的格式相同
+		/// @remark 单个消息内的块链只能串行加密，因此令 SIMD 的各个通道分别处理不同的消息，
+		///         某个通道的消息结束后立即换入下一个消息
+		///         若有任一 Output 的大小不足，将在写入任何数据之前抛出异常
+		void EncryptBatch(gsl::span<const EncryptJob> const& jobs);
 	} // namespace Tea
 
 	namespace Md5
 	{
 		void Calculate(gsl::span<const std::byte> const& input, gsl::span<std::byte, 16> const& output);
 
+		/// @brief  增量地计算 MD5，用于输入由多个部分组成的情况，避免拼接临时的缓冲区
+		class Context
+		{
+		public:
+			Context() noexcept;
+
+			void Update(gsl::span<const std::byte> const& input) noexcept;
+
+			/// @brief  写入结果，之后将重置为初始状态，可用于计算下一个消息
+			void Final(gsl::span<std::byte, 16> const& output) noexcept;
+
+		private:
+			// 存放 MD5_CTX，以免在头文件中包含 OpenSSL 的头文件
+			alignas(std::uint64_t) std::byte m_State[128];
+		};
+
+		/// @brief  计算多个互相独立的消息的 MD5，结果与分别调用 Calculate 相同
+		/// @remark 令 SIMD 的各个通道分别处理不同的消息，某个通道的消息结束后立即换入下一个消息
+		///         inputs 与 outputs 的大小应相同
+		void CalculateBatch(gsl::span<const gsl::span<const std::byte>> const& inputs,
+		                    gsl::span<std::array<std::byte, 16>> const& outputs);
+
 		template <typename Receiver>
 		decltype(auto) Md5ToHexString(gsl::span<const std::byte, 16> const& md5, Receiver&& receiver)
 		{
@@ -70,7 +213,58 @@ namespace YumeBot::Cryptography
 
 	namespace Ecdh
 	{
+		struct KeyPair
+		{
+			std::array<std::byte, 25> PubKey;
+			std::array<std::byte, 16> ShareKey;
+		};
+
+		/// @remark 曲线及服务器的公钥仅在首次调用时准备一次
 		void GenerateKeyPair(gsl::span<std::byte, 25> const& pubKey,
 		                     gsl::span<std::byte, 16> const& shareKey);
+		KeyPair GenerateKeyPair();
+		void GenerateKeyPairs(gsl::span<KeyPair> const& keyPairs);
+
+		/// @brief  由后台线程预先生成并补充的密钥对池
+		/// @remark 剩余数量低于 lowWatermark 时，后台线程将补充至 capacity
+		class KeyPairPool
+		{
+		public:
+			explicit KeyPairPool(std::size_t capacity, std::size_t lowWatermark);
+			explicit KeyPairPool(std::size_t capacity) : KeyPairPool(capacity, capacity / 2)
+			{
+			}
+
+			KeyPairPool(KeyPairPool const&) = delete;
+			KeyPairPool& operator=(KeyPairPool const&) = delete;
+
+			~KeyPairPool();
+
+			/// @brief  取出一个密钥对，池为空时直接在当前线程生成
+			/// @remark 后台线程因异常停止后，将抛出该异常，此后池不再可用
+			KeyPair Acquire();
+
+			std::size_t GetAvailableCount() const;
+
+		private:
+			mutable std::mutex m_Mutex;
+			std::condition_variable m_RefillCondition;
+			std::vector<KeyPair> m_KeyPairs;
+			std::size_t m_Capacity;
+			std::size_t m_LowWatermark;
+			bool m_Stopping;
+			/// @brief  后台线程停止补充的原因
+			std::exception_ptr m_RefillError;
+			std::thread m_RefillThread;
+
+			void RefillThreadMain();
+		};
+
+		/// @brief  设置全局使用的池，传入 nullptr 则不使用池
+		/// @remark 用户需保证池在设置期间有效，KeyStorage(RandomizeTag) 将从中取得密钥对
+		void SetGlobalKeyPairPool(KeyPairPool* pool) noexcept;
+
+		/// @brief  若设置了全局使用的池则从中取出，否则直接生成
+		KeyPair AcquireKeyPair();
 	} // namespace Ecdh
 } // namespace YumeBot::Cryptography
@@ -141,12 +141,16 @@ void JceInputStream::SkipField(JceStruct::TypeEnum type)
 			           Cafe::TextUtils::FormatString(u8"Type mismatch, expected 0, got ${0}"_sv,
 			                                         static_cast<std::uint32_t>(head.Type)));
 		}
-		std::uint8_t size;
+		std::int32_t size;
 		if (!Read(0, size))
 		{
 			CAFE_THROW(JceDecodeException, u8"Read size failed."_sv);
 		}
-		Skip(size);
+		if (size < 0)
+		{
+			CAFE_THROW(JceDecodeException, u8"Invalid size."_sv);
+		}
+		Skip(static_cast<std::size_t>(size));
 		break;
 	}
 	default:
@@ -419,13 +423,13 @@ bool JceInputStream::doRead(std::uint32_t tag, gsl::span<std::byte> const& value
 			                                         static_cast<std::uint32_t>(sizeField.Type)));
 		}
 
-		std::uint8_t size;
+		std::int32_t size;
 		if (!Read(0, size))
 		{
 			CAFE_THROW(JceDecodeException, u8"Read size failed."_sv);
 		}
 
-		if (static_cast<std::size_t>(value.size()) < size)
+		if (size < 0 || value.size() < size)
 		{
 			CAFE_THROW(JceDecodeException, u8"Span is not big enough."_sv);
 		}
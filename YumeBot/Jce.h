@@ -276,12 +276,17 @@ namespace YumeBot::Jce
 							                                  static_cast<std::uint32_t>(sizeField.Type)));
 						}
 
-						std::uint8_t size;
+						std::int32_t size;
 						if (!Read(0, size))
 						{
 							CAFE_THROW(JceDecodeException, CAFE_UTF8_SV("Read size failed."));
 						}
 
+						if (size < 0)
+						{
+							CAFE_THROW(JceDecodeException, CAFE_UTF8_SV("Invalid size."));
+						}
+
 						std::vector<std::byte> tmpList(static_cast<std::size_t>(size));
 						m_Reader.GetStream()->ReadBytes(gsl::make_span(tmpList.data(), size));
 
@@ -1,12 +1,22 @@
 #pragma once
 #include <Cafe/Encoding/CodePage/UTF-8.h>
 #include <ctime>
+#include <gsl/span>
 
 namespace YumeBot
 {
 	using UsingString = Cafe::Encoding::String<Cafe::Encoding::CodePage::Utf8>;
 	using UsingStringView = Cafe::Encoding::StringView<Cafe::Encoding::CodePage::Utf8>;
 
+	/// @brief  将 bytes 视为 UTF-8 字符串
+	inline UsingStringView AsStringView(gsl::span<const std::byte> const& bytes) noexcept
+	{
+		using CharType =
+		    Cafe::Encoding::CodePage::CodePageTrait<Cafe::Encoding::CodePage::Utf8>::CharType;
+		return UsingStringView{ gsl::make_span(reinterpret_cast<const CharType*>(bytes.data()),
+			                                     bytes.size()) };
+	}
+
 	constexpr std::uint32_t DefaultAppId = 537039093;
 	/// @remark 使用短信登录时为 3
 	constexpr std::uint32_t DefualtSigSrc = 1;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "Sso.h"
 #include "Tlv.h"
+#include <atomic>
 
 namespace YumeBot::Request
 {
@@ -24,22 +26,408 @@ namespace YumeBot::Request
 			std::memcpy(RandomKey, randomKey.data(), 16);
 		}
 
+		KeyStorage(Cryptography::Ecdh::KeyPair const& keyPair,
+		           gsl::span<const std::byte, 16> const& randomKey)
+		{
+			std::memcpy(PubKey, keyPair.PubKey.data(), 25);
+			std::memcpy(ShareKey, keyPair.ShareKey.data(), 16);
+			std::memcpy(RandomKey, randomKey.data(), 16);
+		}
+
+		/// @remark 若设置了全局的密钥对池则从中取得 PubKey 及 ShareKey，池的后台线程已失败时抛出其异常
 		explicit KeyStorage(RandomizeTag)
 		{
-			Cryptography::Ecdh::GenerateKeyPair(gsl::make_span(PubKey), gsl::make_span(ShareKey));
+			const auto keyPair = Cryptography::Ecdh::AcquireKeyPair();
+			std::memcpy(PubKey, keyPair.PubKey.data(), 25);
+			std::memcpy(ShareKey, keyPair.ShareKey.data(), 16);
+
+			Cryptography::Random::Fill(RandomKey);
+		}
+	};
+
+	/// @brief  与计算时使用的输入一同保存的值
+	/// @remark 输入以字节的形式保存，取值时与本次的输入比较，不同则重新计算
+	template <typename T>
+	class CachedValue
+	{
+	public:
+		/// @brief  若 inputs 依次拼接的结果与上次相同则返回缓存的值，否则以 factory 重新计算
+		template <typename Factory>
+		T const& Get(std::initializer_list<gsl::span<const std::byte>> inputs, Factory&& factory)
+		{
+			if (!m_Value.has_value() || !IsSameInput(inputs))
+			{
+				m_Value.emplace(std::forward<Factory>(factory)());
+				m_Input.clear();
+				for (const auto input : inputs)
+				{
+					m_Input.insert(m_Input.end(), input.begin(), input.end());
+				}
+			}
+
+			return *m_Value;
+		}
+
+		/// @brief  若 inputs 依次拼接的结果与上次相同则返回缓存的值，否则返回 nullptr
+		/// @remark 不修改缓存，可与其他只读的调用同时进行
+		T const* Find(std::initializer_list<gsl::span<const std::byte>> inputs) const noexcept
+		{
+			return m_Value.has_value() && IsSameInput(inputs) ? &*m_Value : nullptr;
+		}
+
+		/// @brief  若缓存命中则返回缓存的值，否则以 factory 计算但不保存
+		template <typename Factory>
+		T GetOrCalculate(std::initializer_list<gsl::span<const std::byte>> inputs,
+		                 Factory&& factory) const
+		{
+			if (const auto value = Find(inputs))
+			{
+				return *value;
+			}
+
+			return std::forward<Factory>(factory)();
+		}
+
+		void Reset() noexcept
+		{
+			m_Value.reset();
+		}
+
+	private:
+		std::vector<std::byte> m_Input;
+		std::optional<T> m_Value;
+
+		bool IsSameInput(std::initializer_list<gsl::span<const std::byte>> inputs) const noexcept
+		{
+			auto iter = m_Input.begin();
+			for (const auto input : inputs)
+			{
+				const auto size = static_cast<std::size_t>(input.size());
+				if (static_cast<std::size_t>(m_Input.end() - iter) < size ||
+				    !std::equal(input.begin(), input.end(), iter))
+				{
+					return false;
+				}
+				iter += size;
+			}
 
-			std::random_device rd;
-			std::default_random_engine engine{ rd() };
-			std::uniform_int_distribution<> dist{ 0, std::numeric_limits<std::uint8_t>::max() };
-			std::generate(std::begin(RandomKey), std::end(RandomKey),
-			              [&] { return static_cast<std::byte>(dist(engine)); });
+			return iter == m_Input.end();
 		}
 	};
 
+	/// @brief  仅计算一次的值，可由多个线程同时取值
+	/// @remark 尚未保存结果时同时取值的线程均会计算，仅首个取得写入权的结果被保存，不会阻塞任何线程，
+	///         因此 factory 对同一对象应总是返回相同的结果
+	///         复制、赋值及 Reset 不是线程安全的
+	template <typename T>
+	class OnceValue
+	{
+	public:
+		OnceValue() = default;
+
+		OnceValue(OnceValue const& other) : OnceValue{}
+		{
+			*this = other;
+		}
+
+		OnceValue& operator=(OnceValue const& other)
+		{
+			if (other.m_State.load(std::memory_order_acquire) == State::Ready)
+			{
+				m_Value = other.m_Value;
+				m_State.store(State::Ready, std::memory_order_release);
+			}
+			else
+			{
+				m_State.store(State::Empty, std::memory_order_relaxed);
+			}
+
+			return *this;
+		}
+
+		template <typename Factory>
+		T Get(Factory&& factory) const
+		{
+			if (m_State.load(std::memory_order_acquire) == State::Ready)
+			{
+				return m_Value;
+			}
+
+			T value = std::forward<Factory>(factory)();
+			auto expected = State::Empty;
+			if (m_State.compare_exchange_strong(expected, State::Writing, std::memory_order_acquire,
+			                                    std::memory_order_relaxed))
+			{
+				m_Value = value;
+				m_State.store(State::Ready, std::memory_order_release);
+			}
+
+			return value;
+		}
+
+		bool HasValue() const noexcept
+		{
+			return m_State.load(std::memory_order_acquire) == State::Ready;
+		}
+
+		void Reset() noexcept
+		{
+			m_State.store(State::Empty, std::memory_order_relaxed);
+		}
+
+	private:
+		enum class State : std::uint8_t
+		{
+			Empty,
+			Writing,
+			Ready
+		};
+
+		mutable std::atomic<State> m_State{ State::Empty };
+		mutable T m_Value{};
+	};
+
+	/// @brief  可由多个线程同时取得下一个值的 seq
+	/// @remark 从 0 开始以 1 递增，递增至大于 MaxValue 时重新设为 0
+	///         复制时取得当前的值，之后两者互相独立
+	template <std::uint32_t MaxValue>
+	class WrappingSeq
+	{
+	public:
+		WrappingSeq() = default;
+
+		WrappingSeq(WrappingSeq const& other) noexcept
+		    : m_Value{ other.m_Value.load(std::memory_order_relaxed) }
+		{
+		}
+
+		WrappingSeq& operator=(WrappingSeq const& other) noexcept
+		{
+			m_Value.store(other.m_Value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+
+		std::uint32_t Acquire() noexcept
+		{
+			auto value = m_Value.load(std::memory_order_relaxed);
+			while (!m_Value.compare_exchange_weak(value, value >= MaxValue ? 0 : value + 1,
+			                                      std::memory_order_relaxed))
+			{
+			}
+
+			return value;
+		}
+
+	private:
+		std::atomic<std::uint32_t> m_Value{};
+	};
+
+	/// @brief  Msf 的 seq，可由多个线程同时取得下一个值
+	/// @remark 初始值随机自 [0, 100000)，之后以 1 递增，
+	///         递增至大于 1000000 时重新随机到 [60000, 160000)，之后继续以 1 递增
+	///         复制时取得当前的值，之后两者互相独立
+	/// @see    com.tencent.mobileqq.msf.core.MsfCore.getNextSeq()
+	class MsfSeq
+	{
+	public:
+		static constexpr std::uint32_t InitialRange = 100000;
+		static constexpr std::uint32_t MaxValue = 1000000;
+		static constexpr std::uint32_t RerandomizeBase = 60000;
+		static constexpr std::uint32_t RerandomizeRange = 100000;
+
+		static_assert(RerandomizeBase + RerandomizeRange <= MaxValue,
+		              "Rerandomized value should be incremented rather than rerandomized again.");
+
+		MsfSeq() : m_Value{ GetRandomInitialValue() }
+		{
+		}
+
+		MsfSeq(MsfSeq const& other) noexcept : m_Value{ other.m_Value.load(std::memory_order_relaxed) }
+		{
+		}
+
+		MsfSeq& operator=(MsfSeq const& other) noexcept
+		{
+			m_Value.store(other.m_Value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+
+		std::uint32_t Acquire()
+		{
+			auto value = m_Value.load(std::memory_order_relaxed);
+			std::uint32_t next;
+			do
+			{
+				next = value + 1;
+				if (next > MaxValue)
+				{
+					next = RerandomizeBase + Cryptography::Random::NextUInt32() % RerandomizeRange;
+				}
+			} while (!m_Value.compare_exchange_weak(value, next, std::memory_order_relaxed));
+
+			return next;
+		}
+
+		/// @brief  重新随机初始值
+		void Reset()
+		{
+			m_Value.store(GetRandomInitialValue(), std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<std::uint32_t> m_Value;
+
+		static std::uint32_t GetRandomInitialValue()
+		{
+			return Cryptography::Random::NextUInt32() % InitialRange;
+		}
+	};
+
+	/// @brief  缓存由账号信息导出的密钥及摘要
+	/// @remark 每个值与计算时使用的输入一同保存
+	///         非 const 的重载在输入改变时重新计算并保存，用于预先取值
+	///         const 的重载只读取已保存的值，未命中时计算但不保存，可由多个线程同时调用
+	class DerivedKeyCache
+	{
+	public:
+		/// @brief  TlvT<0x106> 的加密密钥
+		Cryptography::Tea::TeaContext const& GetTgtgtKey(gsl::span<const std::byte, 16> const& md5,
+		                                                  std::uint64_t mSalt, std::uint64_t uin)
+		{
+			const auto salt = mSalt ? mSalt : uin;
+			return m_TgtgtKey.Get({ md5, gsl::as_bytes(gsl::make_span(&salt, 1)) },
+			                      [&] { return CalculateTgtgtKey(md5, mSalt, uin); });
+		}
+
+		Cryptography::Tea::TeaContext GetTgtgtKey(gsl::span<const std::byte, 16> const& md5,
+		                                          std::uint64_t mSalt, std::uint64_t uin) const
+		{
+			const auto salt = mSalt ? mSalt : uin;
+			return m_TgtgtKey.GetOrCalculate({ md5, gsl::as_bytes(gsl::make_span(&salt, 1)) },
+			                                 [&] { return CalculateTgtgtKey(md5, mSalt, uin); });
+		}
+
+		/// @brief  以 ShareKey 加密 Body 时使用的密钥
+		Cryptography::Tea::TeaContext const&
+		GetShareKey(gsl::span<const std::byte, 16> const& shareKey)
+		{
+			return m_ShareKey.Get({ shareKey },
+			                      [&] { return Cryptography::Tea::TeaContext{ shareKey }; });
+		}
+
+		Cryptography::Tea::TeaContext GetShareKey(gsl::span<const std::byte, 16> const& shareKey) const
+		{
+			return m_ShareKey.GetOrCalculate(
+			    { shareKey }, [&] { return Cryptography::Tea::TeaContext{ shareKey }; });
+		}
+
+		/// @brief  以 RandomKey 加密 Body 时使用的密钥
+		Cryptography::Tea::TeaContext const&
+		GetRandomKey(gsl::span<const std::byte, 16> const& randomKey)
+		{
+			return m_RandomKey.Get({ randomKey },
+			                       [&] { return Cryptography::Tea::TeaContext{ randomKey }; });
+		}
+
+		Cryptography::Tea::TeaContext
+		GetRandomKey(gsl::span<const std::byte, 16> const& randomKey) const
+		{
+			return m_RandomKey.GetOrCalculate(
+			    { randomKey }, [&] { return Cryptography::Tea::TeaContext{ randomKey }; });
+		}
+
+		/// @brief  以给定的输入取值时是否均能命中缓存
+		bool IsPrepared(gsl::span<const std::byte, 16> const& shareKey,
+		                gsl::span<const std::byte, 16> const& randomKey,
+		                gsl::span<const std::byte, 16> const& md5, std::uint64_t uin) const noexcept
+		{
+			return m_ShareKey.Find({ shareKey }) && m_RandomKey.Find({ randomKey }) &&
+			       m_TgtgtKey.Find({ md5, gsl::as_bytes(gsl::make_span(&uin, 1)) });
+		}
+
+		/// @brief  清除所有已缓存的值
+		void Invalidate() noexcept
+		{
+			m_TgtgtKey.Reset();
+			m_ShareKey.Reset();
+			m_RandomKey.Reset();
+		}
+
+	private:
+		CachedValue<Cryptography::Tea::TeaContext> m_TgtgtKey;
+		CachedValue<Cryptography::Tea::TeaContext> m_ShareKey;
+		CachedValue<Cryptography::Tea::TeaContext> m_RandomKey;
+
+		static Cryptography::Tea::TeaContext
+		CalculateTgtgtKey(gsl::span<const std::byte, 16> const& md5, std::uint64_t mSalt,
+		                  std::uint64_t uin)
+		{
+			return Cryptography::Tea::TeaContext{ Tlv::TlvT<0x106>::CalculateEncryptKey(md5, mSalt,
+			                                                                            uin) };
+		}
+	};
+
+	struct RequestContext;
+
+	/// @brief  缓存由设备及应用的信息决定，不随请求改变的 Tlv 的编码结果
+	/// @remark Get 系列方法在输入改变时重新编码并保存，用于预先取值
+	///         Write 系列方法只读取已保存的编码结果，未命中时直接编码到 builder 而不保存，
+	///         可由多个线程同时调用
+	class StaticTlvCache
+	{
+	public:
+		/// @brief  0x141、0x8、0x147 及 0x177
+		Tlv::EncodedTlvBlock const& GetProfileTlvs(RequestContext const& context, std::uint32_t appId);
+		void WriteProfileTlvs(Tlv::TlvBuilder& builder, RequestContext const& context,
+		                      std::uint32_t appId) const;
+
+		/// @brief  0x187、0x188 及 0x109，对应的值为空时不写入
+		Tlv::EncodedTlvBlock const& GetDeviceIdTlvs(RequestContext const& context);
+		void WriteDeviceIdTlvs(Tlv::TlvBuilder& builder, RequestContext const& context) const;
+
+		/// @brief  以给定的输入取值时是否均能命中缓存
+		bool IsPrepared(RequestContext const& context, std::uint32_t appId) const;
+
+		/// @brief  清除所有已缓存的值
+		void Invalidate() noexcept
+		{
+			m_ProfileTlvs.Reset();
+			m_DeviceIdTlvs.Reset();
+		}
+
+	private:
+		CachedValue<Tlv::EncodedTlvBlock> m_ProfileTlvs;
+		CachedValue<Tlv::EncodedTlvBlock> m_DeviceIdTlvs;
+
+		/// @brief  以缓存的输入调用 func
+		template <typename Func>
+		static decltype(auto) WithProfileInputs(RequestContext const& context, std::uint32_t appId,
+		                                        Func&& func);
+		static void EncodeProfileTlvs(Tlv::TlvBuilder& builder, RequestContext const& context,
+		                              std::uint32_t appId);
+
+		template <typename Func>
+		static decltype(auto) WithDeviceIdInputs(RequestContext const& context, Func&& func);
+		static void EncodeDeviceIdTlvs(Tlv::TlvBuilder& builder, RequestContext const& context);
+
+		template <typename Func>
+		static Tlv::EncodedTlvBlock Encode(Func&& func)
+		{
+			Buffer buffer;
+			Tlv::TlvBuilder builder{ buffer };
+			std::forward<Func>(func)(builder);
+
+			const auto data = buffer.GetSpan();
+			return { { data.begin(), data.end() }, builder.GetTlvCount() };
+		}
+	};
+
+	/// @remark 所有 const 的方法均可由多个线程同时调用，其中缓存只读取已保存的值，
+	///         未命中时计算但不保存，因此共享前应以 PrepareCaches 预先取值
 	struct RequestContext
 	{
-		std::uint32_t Uin;
-		std::array<std::byte, 16> PasswordMd5;
+		std::uint32_t Uin{};
+		std::array<std::byte, 16> PasswordMd5{};
 		std::uint32_t ServerTime = Utility::GetPosixTime();
 		LocaleIdEnum CurrentLocaleId = LocaleIdEnum::ZH_CN;
 
@@ -52,44 +440,258 @@ namespace YumeBot::Request
 		KeyStorage Keys{ KeyStorage::Randomize };
 
 		UsingString SimOperatorName;
-		ConnectionTypeEnum ConnectionType;
+		ConnectionTypeEnum ConnectionType{};
 		UsingString Apn;
 
 		UsingString ApkVersion = DefaultApkVersion;
 		gsl::span<const std::byte> ApkSignature = gsl::as_bytes(gsl::make_span(Signature));
 
 		SsoVersion UsingSsoVersion = SsoVersion::Version8;
-
-		std::array<std::byte, 16> const& GetGuid() const
+		/// @brief  由首个响应取得，之后的请求均使用相同的值
+		std::vector<std::byte> MsgCookie;
+		std::vector<std::byte> Ksid;
+		/// @brief  imsi + "|A" + revision
+		UsingString ClientVerInfo;
+
+		/// @remark 首次调用时由 Imei 及 WifiMac 计算，之后两者的改变需要调用 ResetGuid 才会生效
+		std::array<std::byte, 16> GetGuid() const
 		{
-			if (m_Guid.has_value())
-			{
-				return m_Guid.value();
-			}
+			return m_Guid.Get([&] { return CalculateGuid(Imei.GetView(), WifiMac.GetView()); });
+		}
 
-			const auto tmp = Imei + WifiMac;
+		/// @brief  MD5(Imei + WifiMac)
+		static std::array<std::byte, 16> CalculateGuid(UsingStringView const& imei,
+		                                               UsingStringView const& wifiMac)
+		{
+			Cryptography::Md5::Context md5Context;
+			md5Context.Update(gsl::as_bytes(imei.GetTrimmedSpan()));
+			md5Context.Update(gsl::as_bytes(wifiMac.GetTrimmedSpan()));
 			std::array<std::byte, 16> result;
-			Cryptography::Md5::Calculate(gsl::as_bytes(tmp.GetView().GetTrimmedSpan()),
-			                             gsl::make_span(result));
-			return m_Guid.emplace(result);
+			md5Context.Final(result);
+			return result;
+		}
+
+		/// @remark 不是线程安全的
+		void ResetGuid() noexcept
+		{
+			m_Guid.Reset();
+		}
+
+		Cryptography::Tea::TeaContext GetShareKey() const
+		{
+			return m_DerivedKeys.GetShareKey(Keys.ShareKey);
+		}
+
+		Cryptography::Tea::TeaContext GetRandomKey() const
+		{
+			return m_DerivedKeys.GetRandomKey(Keys.RandomKey);
+		}
+
+		/// @brief  获得由账号信息导出的值的缓存，用于 Tlv 等其他值
+		DerivedKeyCache& GetDerivedKeys() noexcept
+		{
+			return m_DerivedKeys;
+		}
+
+		DerivedKeyCache const& GetDerivedKeys() const noexcept
+		{
+			return m_DerivedKeys;
+		}
+
+		StaticTlvCache& GetStaticTlvs() noexcept
+		{
+			return m_StaticTlvs;
+		}
+
+		StaticTlvCache const& GetStaticTlvs() const noexcept
+		{
+			return m_StaticTlvs;
+		}
+
+		/// @brief  以当前的账号及设备信息预先计算并保存所有缓存的值
+		/// @param  appId 用于 StaticTlvCache::GetProfileTlvs
+		/// @remark 不是线程安全的，应在共享前或相关信息改变后调用
+		void PrepareCaches(std::uint32_t appId = DefaultAppId)
+		{
+			static_cast<void>(m_DerivedKeys.GetShareKey(Keys.ShareKey));
+			static_cast<void>(m_DerivedKeys.GetRandomKey(Keys.RandomKey));
+			static_cast<void>(m_DerivedKeys.GetTgtgtKey(PasswordMd5, 0, Uin));
+			static_cast<void>(m_StaticTlvs.GetProfileTlvs(*this, appId));
+			static_cast<void>(m_StaticTlvs.GetDeviceIdTlvs(*this));
+			m_Guid.Reset();
+			static_cast<void>(GetGuid());
+		}
+
+		/// @brief  PrepareCaches 之后缓存是否仍与当前的信息相符
+		bool IsCachePrepared(std::uint32_t appId = DefaultAppId) const
+		{
+			return m_DerivedKeys.IsPrepared(Keys.ShareKey, Keys.RandomKey, PasswordMd5, Uin) &&
+			       m_StaticTlvs.IsPrepared(*this, appId) && m_Guid.HasValue();
 		}
 
 		std::size_t AcquireRequestSeq() const noexcept
 		{
-			return std::exchange(m_RequestSeq, (m_RequestSeq + 1) % 200);
+			return m_RequestSeq.Acquire();
 		}
 
 		std::size_t AcquireClientSeq() const noexcept
 		{
-			return std::exchange(m_ClientSeq, (m_ClientSeq + 1) % 200);
+			return m_ClientSeq.Acquire();
+		}
+
+		/// @brief  用于 SSO 包装中的 SsoSeq
+		std::uint32_t AcquireMsfSeq() const
+		{
+			return m_MsfSeq.Acquire();
+		}
+
+		/// @brief  重新随机 Msf 的 seq
+		/// @remark 复制时 seq 的当前值也被复制，由同一个上下文复制得到的上下文应分别调用，
+		///         以免各个连接使用相同的 seq
+		void ResetMsfSeq()
+		{
+			m_MsfSeq.Reset();
 		}
 
 	private:
-		mutable std::optional<std::array<std::byte, 16>> m_Guid;
-		mutable std::size_t m_RequestSeq{};
-		mutable std::size_t m_ClientSeq{};
+		DerivedKeyCache m_DerivedKeys;
+		StaticTlvCache m_StaticTlvs;
+		OnceValue<std::array<std::byte, 16>> m_Guid;
+		/// @remark 递增至大于 200 时重新设为 0
+		mutable WrappingSeq<200> m_RequestSeq;
+		mutable WrappingSeq<200> m_ClientSeq;
+		mutable MsfSeq m_MsfSeq;
 	};
 
+	template <typename Func>
+	decltype(auto) StaticTlvCache::WithProfileInputs(RequestContext const& context,
+	                                                 std::uint32_t appId, Func&& func)
+	{
+		const auto operatorName = gsl::as_bytes(context.SimOperatorName.GetView().GetTrimmedSpan());
+		const auto apn = gsl::as_bytes(context.Apn.GetView().GetTrimmedSpan());
+		// 以大小区分两个字符串的边界
+		const std::size_t sizes[]{ static_cast<std::size_t>(operatorName.size()),
+			                         static_cast<std::size_t>(apn.size()) };
+
+		return std::forward<Func>(func)(
+		    { gsl::as_bytes(gsl::make_span(sizes)), operatorName, apn,
+		      gsl::as_bytes(gsl::make_span(&context.ConnectionType, 1)),
+		      gsl::as_bytes(gsl::make_span(&context.CurrentLocaleId, 1)),
+		      gsl::as_bytes(gsl::make_span(&appId, 1)) });
+	}
+
+	inline void StaticTlvCache::EncodeProfileTlvs(Tlv::TlvBuilder& builder,
+	                                              RequestContext const& context, std::uint32_t appId)
+	{
+		builder.WriteTlv(
+		    Tlv::TlvT<0x141>{ context.SimOperatorName, context.ConnectionType, context.Apn });
+		builder.WriteTlv(Tlv::TlvT<0x8>{ 0, context.CurrentLocaleId, 0 });
+		builder.WriteTlv(
+		    Tlv::TlvT<0x147>{ appId, DefaultApkVersion, gsl::as_bytes(gsl::make_span(Signature)) });
+		builder.WriteTlv(Tlv::TlvT<0x177>{ BuildTime, SdkVersion });
+	}
+
+	inline Tlv::EncodedTlvBlock const& StaticTlvCache::GetProfileTlvs(RequestContext const& context,
+	                                                                 std::uint32_t appId)
+	{
+		return WithProfileInputs(
+		    context, appId,
+		    [&](std::initializer_list<gsl::span<const std::byte>> inputs) -> decltype(auto) {
+			    return m_ProfileTlvs.Get(inputs, [&] {
+				    return Encode(
+				        [&](Tlv::TlvBuilder& builder) { EncodeProfileTlvs(builder, context, appId); });
+			    });
+		    });
+	}
+
+	inline void StaticTlvCache::WriteProfileTlvs(Tlv::TlvBuilder& builder,
+	                                             RequestContext const& context,
+	                                             std::uint32_t appId) const
+	{
+		const auto block = WithProfileInputs(
+		    context, appId, [&](std::initializer_list<gsl::span<const std::byte>> inputs) {
+			    return m_ProfileTlvs.Find(inputs);
+		    });
+		if (block)
+		{
+			builder.WriteEncoded(*block);
+		}
+		else
+		{
+			EncodeProfileTlvs(builder, context, appId);
+		}
+	}
+
+	template <typename Func>
+	decltype(auto) StaticTlvCache::WithDeviceIdInputs(RequestContext const& context, Func&& func)
+	{
+		const auto wifiMac = gsl::as_bytes(context.WifiMac.GetView().GetTrimmedSpan());
+		const auto androidId = gsl::as_bytes(context.AndroidId.GetView().GetTrimmedSpan());
+		const auto imei = gsl::as_bytes(context.Imei.GetView().GetTrimmedSpan());
+		const std::size_t sizes[]{ static_cast<std::size_t>(wifiMac.size()),
+			                         static_cast<std::size_t>(androidId.size()),
+			                         static_cast<std::size_t>(imei.size()) };
+
+		return std::forward<Func>(func)(
+		    { gsl::as_bytes(gsl::make_span(sizes)), wifiMac, androidId, imei });
+	}
+
+	inline void StaticTlvCache::EncodeDeviceIdTlvs(Tlv::TlvBuilder& builder,
+	                                               RequestContext const& context)
+	{
+		if (!context.WifiMac.IsEmpty())
+		{
+			builder.WriteTlv(Tlv::TlvT<0x187>{ context.WifiMac });
+		}
+
+		if (!context.AndroidId.IsEmpty())
+		{
+			builder.WriteTlv(Tlv::TlvT<0x188>{ context.AndroidId });
+		}
+
+		if (!context.Imei.IsEmpty())
+		{
+			builder.WriteTlv(Tlv::TlvT<0x109>{ context.Imei });
+		}
+	}
+
+	inline Tlv::EncodedTlvBlock const& StaticTlvCache::GetDeviceIdTlvs(RequestContext const& context)
+	{
+		return WithDeviceIdInputs(
+		    context, [&](std::initializer_list<gsl::span<const std::byte>> inputs) -> decltype(auto) {
+			    return m_DeviceIdTlvs.Get(inputs, [&] {
+				    return Encode([&](Tlv::TlvBuilder& builder) { EncodeDeviceIdTlvs(builder, context); });
+			    });
+		    });
+	}
+
+	inline void StaticTlvCache::WriteDeviceIdTlvs(Tlv::TlvBuilder& builder,
+	                                              RequestContext const& context) const
+	{
+		const auto block = WithDeviceIdInputs(
+		    context, [&](std::initializer_list<gsl::span<const std::byte>> inputs) {
+			    return m_DeviceIdTlvs.Find(inputs);
+		    });
+		if (block)
+		{
+			builder.WriteEncoded(*block);
+		}
+		else
+		{
+			EncodeDeviceIdTlvs(builder, context);
+		}
+	}
+
+	inline bool StaticTlvCache::IsPrepared(RequestContext const& context, std::uint32_t appId) const
+	{
+		using Inputs = std::initializer_list<gsl::span<const std::byte>>;
+		const auto hasProfileTlvs = WithProfileInputs(
+		    context, appId, [&](Inputs inputs) { return m_ProfileTlvs.Find(inputs) != nullptr; });
+		const auto hasDeviceIdTlvs = WithDeviceIdInputs(
+		    context, [&](Inputs inputs) { return m_DeviceIdTlvs.Find(inputs) != nullptr; });
+		return hasProfileTlvs && hasDeviceIdTlvs;
+	}
+
 	/// @brief  加密类型
 	enum class EncryptType
 	{
@@ -104,6 +706,8 @@ namespace YumeBot::Request
 		static constexpr std::uint16_t Cmd = CmdValue;
 		static constexpr std::uint16_t SubCmd = SubCmdValue;
 		static constexpr EncryptType UsingEncryptType = EncryptTypeValue;
+		/// @brief  SSO 包装中的 ServiceCmd，派生类可以隐藏此值
+		static constexpr UsingStringView ServiceCmd = CAFE_UTF8_SV("wtlogin.login");
 
 		void Write(Tlv::TlvBuilder& tlvBuilder, RequestContext const& context, std::size_t seq) const
 		{
@@ -128,174 +732,177 @@ namespace YumeBot::Request
 	public:
 		static constexpr std::size_t RequestHeadSize = 27;
 
+		/// @brief  在请求之前为 SSO 包装预留的空间
+		/// @remark 仅影响性能，不足时将移动数据
+		static constexpr std::size_t SsoHeadroom = 256;
+
+		/// @brief  Body 之前的加密信息的大小
+		template <EncryptType EncryptTypeValue>
+		static constexpr std::size_t EncryptHeadSize =
+		    EncryptTypeValue == EncryptType::Ecdh ? 2 + sizeof(KeyStorage::RandomKey) + 4 +
+		                                                sizeof(KeyStorage::PubKey)
+		                                          : 2 + sizeof(KeyStorage::RandomKey) + 4;
+
 		explicit RequestBuilder(RequestContext context) : m_Context{ std::move(context) }
 		{
+			m_Context.PrepareCaches();
 		}
 
+		/// @brief  在 frame 中构造以 SSO 包装的请求
+		/// @remark SSO 包装写入预留在请求之前的 SsoHeadroom 个字节中，不移动请求
 		/// @return Seq
+		/// @see    BuildRequest
 		template <typename T, std::uint16_t CmdValue, std::uint16_t SubCmdValue,
 		          EncryptType EncryptTypeValue>
-		std::size_t WriteRequest(Cafe::Io::OutputStream* stream,
-		                         RequestBase<T, CmdValue, SubCmdValue, EncryptTypeValue> const& request)
+		std::uint16_t WriteRequest(
+		    Buffer& frame, RequestBase<T, CmdValue, SubCmdValue, EncryptTypeValue> const& request)
 		{
-			const auto seq = m_Context.AcquireRequestSeq();
-
-			Cafe::Io::MemoryStream unencryptedBodyStream;
-			Cafe::Io::BinaryWriter writer{ &unencryptedBodyStream, std::endian::big };
-
-			writer.Write(SubCmdValue);
+			const auto seq = BuildRequest(frame, request);
+			EncodeRequest(frame, T::ServiceCmd);
+			return seq;
+		}
 
-			const auto tlvNumPos = unencryptedBodyStream.GetPosition();
-			writer.Write(std::uint16_t{});
+		/// @brief  在 frame 中构造请求，不包含 SSO 包装
+		/// @remark frame 原有的内容将被清除，已分配的空间将被复用
+		///         Head 及加密信息预先写入，Body 直接在最终位置编码并就地加密，之后填写长度
+		/// @return Seq
+		template <typename T, std::uint16_t CmdValue, std::uint16_t SubCmdValue,
+		          EncryptType EncryptTypeValue>
+		std::uint16_t BuildRequest(
+		    Buffer& frame, RequestBase<T, CmdValue, SubCmdValue, EncryptTypeValue> const& request)
+		{
+			const auto seq = static_cast<std::uint16_t>(m_Context.AcquireRequestSeq());
+
+			frame.Clear(SsoHeadroom);
+			frame.Reserve(m_FrameSizeHint);
+
+			// 写入 Head，总大小在之后填写
+			const auto head =
+			    frame.Append(1 + RequestHeadSize + EncryptHeadSize<EncryptTypeValue>).data();
+			const auto encryptHead = Utility::PackBigEndian(
+			    head, std::uint8_t{ 2 }, std::uint16_t{}, DefaultClientVersion, CmdValue, seq,
+			    m_Context.Uin, std::uint8_t{ 3 }, std::uint8_t{ 7 },
+			    std::uint8_t{},     // retry
+			    std::uint32_t{ 2 }, // ext type
+			    std::uint32_t{},    // app client type
+			    std::uint32_t{}     // ext instance
+			);
+			const auto teaContext = WriteEncryptHead<EncryptTypeValue>(encryptHead);
+
+			// SubCmd 及 Tlv 的数量
+			const auto bodyOffset = frame.GetSize();
+			Utility::StoreBigEndian(frame.Append(4).data(), SubCmdValue);
 
 			const auto tlvNum = [&] {
-				Tlv::TlvBuilder tlvBuilder{ &unencryptedBodyStream };
+				Tlv::TlvBuilder tlvBuilder{ frame };
 				request.Write(tlvBuilder, m_Context, seq);
 				return tlvBuilder.GetTlvCount();
 			}();
 
-			unencryptedBodyStream.SeekFromBegin(tlvNumPos);
-			writer.Write(tlvNum);
-
-			Cafe::Io::MemoryStream requestContentStream;
-			Cafe::Io::BinaryWriter requestWriter{ &requestContentStream, std::endian::big };
-
-			// 写入 Head
-			const auto clientSeq = m_Context.AcquireClientSeq();
-			requestWriter.Write(std::uint8_t{ 2 });
-			const auto totalSizePos = requestContentStream.GetPosition();
-			requestWriter.Write(std::uint16_t{});
-			requestWriter.Write(DefaultClientVersion);
-			requestWriter.Write(CmdValue);
-			requestWriter.Write(seq);
-			requestWriter.Write(m_Context.Uin);
-			requestWriter.Write(std::uint8_t{ 3 });
-			requestWriter.Write(std::uint8_t{ 7 });
-			requestWriter.Write(std::uint8_t{});     // retry
-			requestWriter.Write(std::uint32_t{ 2 }); // ext type
-			requestWriter.Write(std::uint32_t{});    // app client type
-			requestWriter.Write(std::uint32_t{});    // ext instance
-
-			// 写入加密的 Body
-			const auto bodyBeginPos = requestContentStream.GetPosition();
-			EncryptBody<EncryptTypeValue>(&requestContentStream,
-			                              unencryptedBodyStream.GetInternalStorage());
-			const auto bodyEndPos = requestContentStream.GetPosition();
-			const auto bodySize = bodyEndPos - bodyBeginPos;
-
-			requestContentStream.SeekFromBegin(totalSizePos);
-			requestWriter.Write(static_cast<std::uint16_t>(RequestHeadSize + 2 + bodySize));
-
-			requestContentStream.SeekFromBegin(bodyEndPos);
+			assert(tlvNum <= std::numeric_limits<std::uint16_t>::max());
+			Utility::StoreBigEndian(frame.GetData() + bodyOffset + 2,
+			                        static_cast<std::uint16_t>(tlvNum));
+
+			// 就地加密 Body，并预留 End 的空间
+			const auto unencryptedSize = frame.GetSize() - bodyOffset;
+			const auto encryptedSize = Cryptography::Tea::CalculateOutputSize(unencryptedSize);
+			frame.Reserve(encryptedSize - unencryptedSize + 1);
+			frame.Resize(bodyOffset + encryptedSize);
+			teaContext.EncryptInPlace(gsl::make_span(frame.GetData() + bodyOffset, encryptedSize),
+			                          unencryptedSize);
 
 			// 写入 End
-			requestWriter.Write(std::uint8_t{ 3 });
+			frame.Append(1)[0] = std::byte{ 3 };
 
-			EncodeRequest(stream, requestContentStream.GetInternalStorage());
+			const auto totalSize = frame.GetSize();
+			assert(totalSize == RequestHeadSize + 2 + EncryptHeadSize<EncryptTypeValue> + encryptedSize);
+			assert(totalSize <= std::numeric_limits<std::uint16_t>::max());
+			Utility::StoreBigEndian(frame.GetData() + 1, static_cast<std::uint16_t>(totalSize));
 
+			m_FrameSizeHint = std::max(m_FrameSizeHint, totalSize);
 			return seq;
 		}
 
+		/// @brief  写入 Body 之前的加密信息
+		/// @param  encryptHead 应具有 EncryptHeadSize<EncryptTypeValue> 个字节
+		/// @return 用于加密 Body 的密钥
 		template <EncryptType EncryptTypeValue>
-		void EncryptBody(Cafe::Io::OutputStream* stream, gsl::span<const std::byte> const& body)
+		Cryptography::Tea::TeaContext WriteEncryptHead(std::byte* encryptHead) const
 		{
-			Cafe::Io::BinaryWriter writer{ stream, std::endian::big };
-
-			const auto teaKey = [&] {
-				if constexpr (EncryptTypeValue == EncryptType::Ecdh)
-				{
-					writer.Write(std::uint16_t{ 0x0101 });
-					stream->WriteBytes(gsl::make_span(m_Context.Keys.RandomKey));
-					writer.Write(std::uint16_t{ 0x0102 });
-					writer.Write(static_cast<std::uint16_t>(sizeof m_Context.Keys.PubKey));
-					stream->WriteBytes(gsl::make_span(m_Context.Keys.PubKey));
-
-					return Cryptography::Tea::FormatKey(m_Context.Keys.ShareKey);
-				}
-				else
-				{
-					writer.Write(std::uint16_t{ 0x0102 });
-					stream->WriteBytes(gsl::make_span(m_Context.Keys.RandomKey));
-					writer.Write(std::uint16_t{ 0x0102 });
-					writer.Write(std::uint16_t{});
-
-					return Cryptography::Tea::FormatKey(m_Context.Keys.RandomKey);
-				}
-			}();
-			Cryptography::Tea::Encrypt(body, stream, teaKey);
-		}
-
-		void EncodeRequest(Cafe::Io::OutputStream* stream, gsl::span<const std::byte> const& request)
-		{
-			if (m_Context.UsingSsoVersion == SsoVersion::Version8)
+			auto& keys = m_Context.Keys;
+			if constexpr (EncryptTypeValue == EncryptType::Ecdh)
 			{
-				EncodeRequestV8(stream, request);
+				encryptHead = Utility::PackBigEndian(encryptHead, std::uint16_t{ 0x0101 });
+				std::memcpy(encryptHead, keys.RandomKey, sizeof keys.RandomKey);
+				encryptHead = Utility::PackBigEndian(encryptHead + sizeof keys.RandomKey,
+				                                     std::uint16_t{ 0x0102 },
+				                                     static_cast<std::uint16_t>(sizeof keys.PubKey));
+				std::memcpy(encryptHead, keys.PubKey, sizeof keys.PubKey);
+
+				return m_Context.GetShareKey();
 			}
 			else
 			{
-				assert(m_Context.UsingSsoVersion == SsoVersion::Version9);
-				EncodeRequestV9(stream, request);
+				encryptHead = Utility::PackBigEndian(encryptHead, std::uint16_t{ 0x0102 });
+				std::memcpy(encryptHead, keys.RandomKey, sizeof keys.RandomKey);
+				Utility::PackBigEndian(encryptHead + sizeof keys.RandomKey, std::uint16_t{ 0x0102 },
+				                       std::uint16_t{});
+
+				return m_Context.GetRandomKey();
 			}
 		}
 
-	private:
-		RequestContext m_Context;
-
-		void EncodeRequestV8(Cafe::Io::OutputStream* stream, gsl::span<const std::byte> const& request)
+		/// @brief  在 frame 的数据之前写入 SSO 包装
+		/// @remark 登录相关的请求以 16 字节的 0 作为密钥加密
+		void EncodeRequest(Buffer& frame, UsingStringView const& serviceCmd)
 		{
-			constexpr std::uint32_t ssoVersion = static_cast<std::uint32_t>(SsoVersion::Version8);
-
-			Cafe::Io::BinaryWriter writer{ stream, std::endian::big };
-			writer.Write(ssoVersion);
-			writer.Write(std::uint8_t{}); // unknown byte
-			
+			Sso::RequestHead head{};
+			head.Version = m_Context.UsingSsoVersion;
+			head.Encrypt = Sso::EncryptFlag::EmptyKey;
+			head.Uin = m_Context.Uin;
+			head.SsoSeq = m_Context.AcquireMsfSeq();
+			head.AppId = DefaultAppId;
+			head.MsfAppId = DefaultAppId;
+			head.ServiceCmd = serviceCmd;
+			head.MsgCookie = m_Context.MsgCookie;
+			head.Imei = m_Context.Imei.GetView();
+			head.Ksid = m_Context.Ksid;
+			head.ClientVerInfo = m_Context.ClientVerInfo.GetView();
+
+			Sso::EncodeRequest(frame, head);
 		}
 
-		void EncodeRequestV9(Cafe::Io::OutputStream* stream, gsl::span<const std::byte> const& request)
-		{
-			// TODO
-		}
+	private:
+		RequestContext m_Context;
+		/// @brief  之前构造的请求的最大大小，用于预先分配空间
+		std::size_t m_FrameSizeHint = 1024;
 	};
 
 	struct RequestTGTGT : RequestBase<RequestTGTGT, 2064, 9, EncryptType::Ecdh>
 	{
 		void DoWrite(Tlv::TlvBuilder& tlvBuilder, RequestContext const& context, std::size_t seq) const
 		{
-			const auto& guid = context.GetGuid();
+			const auto guid = context.GetGuid();
+			const auto tgtgtKey = context.GetDerivedKeys().GetTgtgtKey(PasswordMd5, 0, Uin);
 
 			tlvBuilder.WriteTlv(Tlv::TlvT<0x106>{ AppId, SubAppId, ClientVersion, Uin, InitTime, ClientIp,
-			                                      false, PasswordMd5, 0, TGTGTKey, false, guid, 1 });
+			                                      false, PasswordMd5, 0, TGTGTKey, false, guid, 1,
+			                                      &tgtgtKey });
 			tlvBuilder.WriteTlv(Tlv::TlvT<0x100>{ AppId, SubAppId, WxAppId, GetSig1 });
 			tlvBuilder.WriteTlv(Tlv::TlvT<0x107>{ PicType, CapType, PicSize, RetType });
 			tlvBuilder.WriteTlv(Tlv::TlvT<0x116>{ Bitmap, GetSig, SubAppIdList });
 			tlvBuilder.WriteTlv(Tlv::TlvT<0x145>{ guid });
 			tlvBuilder.WriteTlv(Tlv::TlvT<0x154>{ static_cast<std::uint32_t>(seq) });
-			tlvBuilder.WriteTlv(
-			    Tlv::TlvT<0x141>{ context.SimOperatorName, context.ConnectionType, context.Apn });
-			tlvBuilder.WriteTlv(Tlv::TlvT<0x8>{ 0, context.CurrentLocaleId, 0 });
-			tlvBuilder.WriteTlv(
-			    Tlv::TlvT<0x147>{ AppId, DefaultApkVersion, gsl::as_bytes(gsl::make_span(Signature)) });
-			tlvBuilder.WriteTlv(Tlv::TlvT<0x177>{ BuildTime, SdkVersion });
 
-			if (!Ksid.empty())
-			{
-				tlvBuilder.WriteTlv(Tlv::TlvT<0x108>{ std::vector<std::byte>(Ksid.begin(), Ksid.end()) });
-			}
-
-			if (!context.WifiMac.IsEmpty())
-			{
-				tlvBuilder.WriteTlv(Tlv::TlvT<0x187>{ context.WifiMac });
-			}
+			auto& staticTlvs = context.GetStaticTlvs();
+			staticTlvs.WriteProfileTlvs(tlvBuilder, context, AppId);
 
-			if (!context.AndroidId.IsEmpty())
+			if (!Ksid.empty())
 			{
-				tlvBuilder.WriteTlv(Tlv::TlvT<0x188>{ context.AndroidId });
+				tlvBuilder.WriteTlv(Tlv::TlvT<0x108>{ Ksid });
 			}
 
-			if (!context.Imei.IsEmpty())
-			{
-				tlvBuilder.WriteTlv(Tlv::TlvT<0x109>{ context.Imei });
-			}
+			staticTlvs.WriteDeviceIdTlvs(tlvBuilder, context);
 
 			// TODO
 		}
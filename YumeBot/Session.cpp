@@ -2,6 +2,12 @@
 
 using namespace YumeBot;
 
+namespace
+{
+	/// @brief  每组的账号数量，组内共享生成密钥对时使用的上下文
+	constexpr std::size_t PrepareGroupSize = 16;
+} // namespace
+
 SessionFactory::UserPassword::UserPassword(UsingStringView const& password) noexcept
 {
 	Cryptography::Md5::Calculate(gsl::as_bytes(password.GetTrimmedSpan()), PasswordMd5);
@@ -22,3 +28,38 @@ Request::RequestContext& SessionFactory::GetContext()
 {
 	return m_CommonInitialContext;
 }
+
+std::vector<Request::RequestContext>
+SessionFactory::PrepareContexts(gsl::span<const Account> const& accounts,
+                                Utility::Executor const& executor) const
+{
+	const auto accountCount = static_cast<std::size_t>(accounts.size());
+	// 复制不会生成密钥，密钥将在之后统一写入
+	std::vector<Request::RequestContext> result(accountCount, m_CommonInitialContext);
+
+	const auto groupCount = (accountCount + PrepareGroupSize - 1) / PrepareGroupSize;
+	Utility::ParallelFor(executor, groupCount, [&](std::size_t group) {
+		const auto begin = group * PrepareGroupSize;
+		const auto size = std::min(PrepareGroupSize, accountCount - begin);
+
+		Cryptography::Ecdh::KeyPair keyPairs[PrepareGroupSize];
+		Cryptography::Ecdh::GenerateKeyPairs(gsl::make_span(keyPairs, size));
+
+		std::byte randomKeys[PrepareGroupSize][16];
+		Cryptography::Random::Fill(gsl::make_span(&randomKeys[0][0], size * 16));
+
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			const auto& account = accounts[begin + i];
+			auto& context = result[begin + i];
+			context.Uin = account.Uin;
+			context.PasswordMd5 = account.Password.PasswordMd5;
+			context.Keys = Request::KeyStorage{ keyPairs[i], randomKeys[i] };
+
+			context.ResetMsfSeq();
+			context.PrepareCaches();
+		}
+	});
+
+	return result;
+}
@@ -82,10 +82,10 @@ namespace YumeBot
 			template <typename LoginCallback>
 			void Login(LoginCallback&& callback)
 			{
-				Cafe::Io::MemoryStream stream;
+				Buffer frame;
 				// TODO
-				m_RequestBuilder.WriteRequest(stream, Request::RequestTGTGT{});
-				m_Socket.PushData(stream.GetInternalStorage());
+				m_RequestBuilder.WriteRequest(frame, Request::RequestTGTGT{});
+				m_Socket.PushData(frame.GetSpan());
 
 				// TODO: 验证 Response
 				throw std::runtime_error("Not implemented");
@@ -109,6 +109,7 @@ namespace YumeBot
 
 		/// @brief  以 Uin、密码及用户指定的 Socket 构建会话
 		/// @remark 会话不具有 Socket 的所有权，用户需自行保证在会话有效期间有效
+		///         每个会话使用新生成的密钥，不与共同初始化上下文共享
 		template <typename TSocketImpl>
 		std::unique_ptr<Session<TSocketImpl>> CreateSession(std::uint32_t uin, UserPassword password,
 		                                                    AbstractSocket<TSocketImpl>& socket)
@@ -116,9 +117,31 @@ namespace YumeBot
 			Request::RequestContext context = m_CommonInitialContext;
 			context.Uin = uin;
 			context.PasswordMd5 = password.PasswordMd5;
-			return std::make_unique<Session>(socket, std::move(context));
+			context.Keys = Request::KeyStorage{ Request::KeyStorage::Randomize };
+			context.ResetMsfSeq();
+			return CreateSession(std::move(context), socket);
 		}
 
+		/// @brief  以 PrepareContexts 准备的上下文及用户指定的 Socket 构建会话
+		template <typename TSocketImpl>
+		std::unique_ptr<Session<TSocketImpl>> CreateSession(Request::RequestContext context,
+		                                                    AbstractSocket<TSocketImpl>& socket)
+		{
+			return std::make_unique<Session<TSocketImpl>>(socket, std::move(context));
+		}
+
+		struct Account
+		{
+			std::uint32_t Uin;
+			UserPassword Password;
+		};
+
+		/// @brief  为多个账号准备上下文，可分别传入 CreateSession 构建会话
+		/// @remark 账号被分为若干组并通过 executor 并行处理，每组的密钥对一同生成
+		///         同时预先计算各个账号的缓存并重新随机 Msf 的 seq，返回的上下文与 accounts 一一对应
+		std::vector<Request::RequestContext> PrepareContexts(gsl::span<const Account> const& accounts,
+		                                                     Utility::Executor const& executor) const;
+
 	private:
 		Request::RequestContext m_CommonInitialContext;
 	};
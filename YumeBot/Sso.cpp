@@ -0,0 +1,244 @@
+#include "Sso.h"
+#include "Utility.h"
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+
+using namespace YumeBot;
+using namespace Sso;
+
+namespace
+{
+	/// @brief  响应中 Head 的最小大小，即长度、版本、加密方式、未知字节及空 Uin 的长度
+	constexpr std::size_t MinPackageSize = 4 + 4 + 1 + 1 + 4;
+
+	/// @brief  CSSOReqHead 中 MsfAppId 之后的固定部分，首字节为 m_B2Value
+	constexpr std::size_t ReqHeadFixedSize = 12;
+	constexpr std::uint8_t ReqHeadB2Value = 2;
+
+	/// @brief  SSO 中的长度包含长度字段自身
+	template <typename SizeType>
+	constexpr std::size_t GetSizedSize(gsl::span<const std::byte> const& value) noexcept
+	{
+		return sizeof(SizeType) + static_cast<std::size_t>(value.size());
+	}
+
+	template <typename SizeType>
+	std::byte* WriteSized(std::byte* dest, gsl::span<const std::byte> const& value) noexcept
+	{
+		const auto size = static_cast<std::size_t>(value.size());
+		assert(size + sizeof(SizeType) <= std::numeric_limits<SizeType>::max());
+		dest = Utility::PackBigEndian(dest, static_cast<SizeType>(size + sizeof(SizeType)));
+		if (size)
+		{
+			std::memcpy(dest, value.data(), size);
+		}
+		return dest + size;
+	}
+
+	Cryptography::Tea::TeaContext const& GetKey(EncryptFlag encrypt,
+	                                            Cryptography::Tea::TeaContext const* d2Key)
+	{
+		switch (encrypt)
+		{
+		case EncryptFlag::D2Key:
+			if (!d2Key)
+			{
+				CAFE_THROW(SsoException, CAFE_UTF8_SV("D2Key is required."));
+			}
+			return *d2Key;
+		case EncryptFlag::EmptyKey:
+		{
+			static const std::array<std::byte, 16> emptyKeyBytes{};
+			static const Cryptography::Tea::TeaContext emptyKey{ gsl::make_span(emptyKeyBytes) };
+			return emptyKey;
+		}
+		default:
+			CAFE_THROW(SsoException, CAFE_UTF8_SV("Invalid encrypt flag."));
+		}
+	}
+
+	/// @brief  顺序读取包的内容，取得的视图直接指向包
+	class PackageReader
+	{
+	public:
+		explicit PackageReader(gsl::span<std::byte> const& data) noexcept : m_Data{ data }
+		{
+		}
+
+		template <typename T>
+		T Read()
+		{
+			return Utility::LoadBigEndian<T>(ReadBytes(sizeof(T)).data());
+		}
+
+		gsl::span<std::byte> ReadBytes(std::size_t size)
+		{
+			if (static_cast<std::size_t>(m_Data.size()) < size)
+			{
+				CAFE_THROW(SsoException, CAFE_UTF8_SV("Unexpected end of package."));
+			}
+
+			const auto result = m_Data.first(size);
+			m_Data = m_Data.subspan(size);
+			return result;
+		}
+
+		/// @brief  读取以 SizeType 类型的长度为前缀的字节，长度包含前缀自身
+		template <typename SizeType>
+		gsl::span<std::byte> ReadSized()
+		{
+			const std::size_t size = Read<SizeType>();
+			if (size < sizeof(SizeType))
+			{
+				CAFE_THROW(SsoException, CAFE_UTF8_SV("Invalid size."));
+			}
+			return ReadBytes(size - sizeof(SizeType));
+		}
+
+		gsl::span<std::byte> ReadRemaining() noexcept
+		{
+			return std::exchange(m_Data, {});
+		}
+
+	private:
+		gsl::span<std::byte> m_Data;
+	};
+} // namespace
+
+void Sso::EncodeRequest(Buffer& frame, RequestHead const& head)
+{
+	const auto isVersion9 = head.Version == SsoVersion::Version9;
+	const auto serviceCmd = gsl::as_bytes(head.ServiceCmd.GetTrimmedSpan());
+	const auto imei = gsl::as_bytes(head.Imei.GetTrimmedSpan());
+	const auto clientVerInfo = gsl::as_bytes(head.ClientVerInfo.GetTrimmedSpan());
+	const auto timeStat = gsl::as_bytes(head.TimeStat.GetTrimmedSpan());
+
+	char uinBuffer[std::numeric_limits<std::uint32_t>::digits10 + 1];
+	const auto uinEnd = std::to_chars(std::begin(uinBuffer), std::end(uinBuffer), head.Uin).ptr;
+	const auto uin = gsl::as_bytes(gsl::make_span(uinBuffer, uinEnd));
+
+	// 请求头的长度不包含之后负载的长度字段
+	const auto reqHeadSize =
+	    4 + 4 + 4 + 4 + ReqHeadFixedSize + GetSizedSize<std::uint32_t>(head.A2) +
+	    GetSizedSize<std::uint32_t>(serviceCmd) + GetSizedSize<std::uint32_t>(head.MsgCookie) +
+	    GetSizedSize<std::uint32_t>(imei) + GetSizedSize<std::uint32_t>(head.Ksid) +
+	    GetSizedSize<std::uint16_t>(clientVerInfo) +
+	    (isVersion9 ? GetSizedSize<std::uint32_t>(timeStat) : 0);
+	const auto unencryptedSize = reqHeadSize + 4 + frame.GetSize();
+	const auto encryptedSize = head.Encrypt == EncryptFlag::None
+	                               ? unencryptedSize
+	                               : Cryptography::Tea::CalculateOutputSize(unencryptedSize);
+	const auto ssoHeadSize = 4 + 4 + 1 + GetSizedSize<std::uint32_t>(head.D2) + 1 +
+	                         GetSizedSize<std::uint32_t>(uin);
+	const auto totalSize = ssoHeadSize + encryptedSize;
+	if (totalSize > MaxPackageSize)
+	{
+		CAFE_THROW(SsoException, CAFE_UTF8_SV("Package is too large."));
+	}
+
+	const auto payloadSize = frame.GetSize();
+	auto reqHead = frame.Prepend(reqHeadSize + 4).data();
+	reqHead = Utility::PackBigEndian(reqHead, static_cast<std::uint32_t>(reqHeadSize), head.SsoSeq,
+	                                 head.AppId, head.MsfAppId, ReqHeadB2Value);
+	std::memset(reqHead, 0, ReqHeadFixedSize - 1);
+	reqHead += ReqHeadFixedSize - 1;
+	reqHead = WriteSized<std::uint32_t>(reqHead, head.A2);
+	reqHead = WriteSized<std::uint32_t>(reqHead, serviceCmd);
+	reqHead = WriteSized<std::uint32_t>(reqHead, head.MsgCookie);
+	reqHead = WriteSized<std::uint32_t>(reqHead, imei);
+	reqHead = WriteSized<std::uint32_t>(reqHead, head.Ksid);
+	reqHead = WriteSized<std::uint16_t>(reqHead, clientVerInfo);
+	if (isVersion9)
+	{
+		reqHead = WriteSized<std::uint32_t>(reqHead, timeStat);
+	}
+	Utility::StoreBigEndian(reqHead, static_cast<std::uint32_t>(payloadSize + 4));
+
+	if (head.Encrypt != EncryptFlag::None)
+	{
+		const auto& key = GetKey(head.Encrypt, head.D2Key);
+		frame.Resize(encryptedSize);
+		key.EncryptInPlace(frame.GetSpan(), unencryptedSize);
+	}
+
+	auto ssoHead = frame.Prepend(ssoHeadSize).data();
+	ssoHead = Utility::PackBigEndian(ssoHead, static_cast<std::uint32_t>(totalSize),
+	                                 static_cast<std::uint32_t>(head.Version),
+	                                 static_cast<std::uint8_t>(head.Encrypt));
+	ssoHead = WriteSized<std::uint32_t>(ssoHead, head.D2);
+	ssoHead = Utility::PackBigEndian(ssoHead, std::uint8_t{});
+	WriteSized<std::uint32_t>(ssoHead, uin);
+
+	assert(frame.GetSize() == totalSize);
+}
+
+std::optional<std::size_t> Sso::GetPackageSize(gsl::span<const std::byte> const& data)
+{
+	if (data.size() < 4)
+	{
+		return {};
+	}
+
+	const std::size_t size = Utility::LoadBigEndian<std::uint32_t>(data.data());
+	if (size < MinPackageSize || size > MaxPackageSize)
+	{
+		CAFE_THROW(SsoException, CAFE_UTF8_SV("Invalid package size."));
+	}
+
+	return size;
+}
+
+Response Sso::DecodeResponse(gsl::span<std::byte> const& package,
+                             Cryptography::Tea::TeaContext const* d2Key)
+{
+	const auto packageSize = GetPackageSize(package);
+	if (packageSize != static_cast<std::size_t>(package.size()))
+	{
+		CAFE_THROW(SsoException, CAFE_UTF8_SV("Package size mismatch."));
+	}
+
+	Response response;
+	auto& head = response.Head;
+
+	PackageReader reader{ package.subspan(4) };
+	const auto version = reader.Read<std::uint32_t>();
+	if (version != static_cast<std::uint32_t>(SsoVersion::Version8) &&
+	    version != static_cast<std::uint32_t>(SsoVersion::Version9))
+	{
+		CAFE_THROW(SsoException, CAFE_UTF8_SV("Unsupported sso version."));
+	}
+	head.Version = static_cast<SsoVersion>(version);
+	head.Encrypt = static_cast<EncryptFlag>(reader.Read<std::uint8_t>());
+	reader.Read<std::uint8_t>(); // unknown byte
+	head.Uin = AsStringView(reader.ReadSized<std::uint32_t>());
+
+	auto body = reader.ReadRemaining();
+	if (head.Encrypt != EncryptFlag::None)
+	{
+		const auto& key = GetKey(head.Encrypt, d2Key);
+		try
+		{
+			body = key.DecryptInPlace(body);
+		}
+		catch (Cryptography::CryptoException&)
+		{
+			// 长度不为块大小的整数倍或填充无效
+			CAFE_THROW(SsoException, CAFE_UTF8_SV("Invalid encrypted body."));
+		}
+	}
+
+	PackageReader bodyReader{ body };
+	// 响应头的长度包含长度字段自身，按长度跳过未知的字段
+	PackageReader headReader{ bodyReader.ReadSized<std::uint32_t>() };
+	head.SsoSeq = headReader.Read<std::uint32_t>();
+	head.ReturnCode = headReader.Read<std::int32_t>();
+	head.ErrorMessage = AsStringView(headReader.ReadSized<std::uint32_t>());
+	head.ServiceCmd = AsStringView(headReader.ReadSized<std::uint32_t>());
+	head.MsgCookie = headReader.ReadSized<std::uint32_t>();
+	head.CompressFlag = headReader.Read<std::uint32_t>();
+
+	response.Payload = bodyReader.ReadSized<std::uint32_t>();
+	return response;
+}
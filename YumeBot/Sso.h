@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Cryptography.h"
+#include "Misc.h"
+#include <Cafe/ErrorHandling/ErrorHandling.h>
+#include <optional>
+
+namespace YumeBot::Sso
+{
+	CAFE_DEFINE_GENERAL_EXCEPTION(SsoException);
+
+	/// @brief  单个 SSO 包的最大大小
+	/// @remark 与 CCodecWarpper::m_MaxPackageSize 的默认值相同
+	constexpr std::size_t MaxPackageSize = 0x00100000;
+
+	/// @brief  SSO 包中 Head 之后部分的加密方式
+	enum class EncryptFlag : std::uint8_t
+	{
+		None = 0,
+		D2Key = 1,
+		/// @brief  以 16 字节的 0 作为密钥，用于登录等尚未取得 D2Key 的请求
+		EmptyKey = 2
+	};
+
+	/// @brief  请求的 SSO 包装
+	/// @remark 对应 CSSOHead 及 CSSOReqHead，视图应在编码期间保持有效
+	struct RequestHead
+	{
+		SsoVersion Version;
+		EncryptFlag Encrypt;
+		gsl::span<const std::byte> D2;
+		std::uint32_t Uin;
+
+		std::uint32_t SsoSeq;
+		std::uint32_t AppId;
+		std::uint32_t MsfAppId;
+		gsl::span<const std::byte> A2;
+		UsingStringView ServiceCmd;
+		gsl::span<const std::byte> MsgCookie;
+		UsingStringView Imei;
+		gsl::span<const std::byte> Ksid;
+		/// @brief  imsi + "|A" + revision
+		UsingStringView ClientVerInfo;
+		/// @brief  仅用于 SsoVersion::Version9
+		UsingStringView TimeStat;
+
+		/// @brief  Encrypt 为 EncryptFlag::D2Key 时使用
+		Cryptography::Tea::TeaContext const* D2Key = nullptr;
+	};
+
+	/// @brief  在 frame 的数据之前写入 SSO 包装
+	/// @remark frame 中已有的数据作为负载，不会被复制，需要加密时将与请求头一同就地加密
+	///         包的大小超过 MaxPackageSize 时抛出 SsoException
+	void EncodeRequest(Buffer& frame, RequestHead const& head);
+
+	/// @brief  响应的 SSO 包装
+	/// @remark 视图均指向被解析的包
+	struct ResponseHead
+	{
+		SsoVersion Version;
+		EncryptFlag Encrypt;
+		UsingStringView Uin;
+
+		std::uint32_t SsoSeq;
+		std::int32_t ReturnCode;
+		UsingStringView ErrorMessage;
+		UsingStringView ServiceCmd;
+		gsl::span<const std::byte> MsgCookie;
+		/// @brief  负载的压缩方式，为 1 时以 zlib 压缩
+		std::uint32_t CompressFlag;
+	};
+
+	struct Response
+	{
+		ResponseHead Head;
+		gsl::span<std::byte> Payload;
+	};
+
+	/// @brief  取得 data 起始处的 SSO 包的大小，用于从连接中划分出完整的包
+	/// @remark 大小不合法或超过 MaxPackageSize 时抛出 SsoException
+	/// @return data 不足以确定大小时返回 std::nullopt
+	std::optional<std::size_t> GetPackageSize(gsl::span<const std::byte> const& data);
+
+	/// @brief  就地解析完整的 SSO 包
+	/// @param  package 应恰好为一个完整的包，需要时将被就地解密
+	/// @param  d2Key 包以 EncryptFlag::D2Key 加密时使用
+	/// @remark 包不合法（包括无法解密）时抛出 SsoException，负载不会被复制
+	Response DecodeResponse(gsl::span<std::byte> const& package,
+	                        Cryptography::Tea::TeaContext const* d2Key = nullptr);
+} // namespace YumeBot::Sso
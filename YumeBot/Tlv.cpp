@@ -3,10 +3,15 @@
 using namespace YumeBot;
 using namespace Tlv;
 
-TlvBuilder::TlvBuilder(Cafe::Io::OutputStream* stream, std::size_t initialTlvCount)
-    : m_Writer{ stream, std::endian::big }, m_TlvCount{ initialTlvCount }
+TlvBuilder::TlvBuilder(Buffer& buffer, std::size_t initialTlvCount)
+    : m_Buffer{ buffer }, m_Writer{ &buffer, std::endian::big }, m_TlvCount{ initialTlvCount }
 {
-	assert(dynamic_cast<Cafe::Io::SeekableStreamBase*>(stream) && "stream should be seekable.");
+}
+
+void TlvBuilder::WriteEncoded(EncodedTlvBlock const& block)
+{
+	m_Buffer.WriteBytes(block.Data);
+	m_TlvCount += block.TlvCount;
 }
 
 std::size_t TlvBuilder::GetTlvCount() const noexcept
@@ -14,7 +19,228 @@ std::size_t TlvBuilder::GetTlvCount() const noexcept
 	return m_TlvCount;
 }
 
-TlvReader::TlvReader(Cafe::Io::InputStream* stream) : m_Reader{ stream, std::endian::big }
+Buffer& TlvBuilder::GetBuffer() const noexcept
+{
+	return m_Buffer;
+}
+
+void TlvBuilder::WriteHeader(std::byte* header, std::uint16_t cmd, std::size_t bodySize) noexcept
+{
+	Utility::StoreBigEndian(header, cmd);
+	Utility::StoreBigEndian(header + 2, static_cast<std::uint16_t>(bodySize));
+}
+
+std::size_t TlvBuilder::BeginEncryptedTlv()
+{
+	const auto headerOffset = m_Buffer.GetSize();
+	m_Buffer.Append(6);
+	return headerOffset;
+}
+
+void TlvBuilder::EndEncryptedTlv(std::size_t headerOffset, std::uint16_t cmd,
+                                 Cryptography::Tea::TeaContext const& key,
+                                 std::size_t innerTlvCount)
+{
+	assert(innerTlvCount <= std::numeric_limits<std::uint16_t>::max());
+
+	const auto bodyOffset = headerOffset + 4;
+	const auto unencryptedSize = m_Buffer.GetSize() - bodyOffset;
+	const auto encryptedSize = Cryptography::Tea::CalculateOutputSize(unencryptedSize);
+	assert(encryptedSize <= std::numeric_limits<std::uint16_t>::max());
+
+	// 预先增长至密文的大小，之后不会再移动数据
+	m_Buffer.Resize(bodyOffset + encryptedSize);
+	const auto data = m_Buffer.GetData();
+	Utility::StoreBigEndian(data + bodyOffset, static_cast<std::uint16_t>(innerTlvCount));
+
+	const auto size =
+	    key.EncryptInPlace(gsl::make_span(data + bodyOffset, encryptedSize), unencryptedSize);
+	m_Buffer.Resize(bodyOffset + size);
+
+	WriteHeader(data + headerOffset, cmd, size);
+	++m_TlvCount;
+}
+
+BodyReader::BodyReader(gsl::span<const std::byte> const& body) noexcept : m_Body{ body }
+{
+}
+
+gsl::span<const std::byte> BodyReader::ReadBytes(std::size_t size)
+{
+	if (static_cast<std::size_t>(m_Body.size()) < size)
+	{
+		CAFE_THROW(TlvDecodeException, CAFE_UTF8_SV("Unexpected end of tlv body."));
+	}
+
+	const auto result = m_Body.first(size);
+	m_Body = m_Body.subspan(size);
+	return result;
+}
+
+gsl::span<const std::byte> BodyReader::ReadRemaining() noexcept
+{
+	return std::exchange(m_Body, {});
+}
+
+TlvReader::TlvReader(gsl::span<const std::byte> const& data)
+    : m_Data{ data }, m_Stream{}, m_SeekableStream{}
+{
+	const auto dataSize = static_cast<std::size_t>(data.size());
+	for (std::size_t offset = 0; dataSize - offset >= 4;)
+	{
+		const auto cmd = Utility::LoadBigEndian<std::uint16_t>(data.data() + offset);
+		const auto bodySize = Utility::LoadBigEndian<std::uint16_t>(data.data() + offset + 2);
+		offset += 4;
+		if (dataSize - offset < bodySize)
+		{
+			break;
+		}
+
+		m_Entries.push_back({ cmd, bodySize, offset });
+		offset += bodySize;
+	}
+
+	BuildIndex();
+}
+
+TlvReader::TlvReader(Cafe::Io::InputStream* stream)
+    : m_Stream{ stream }, m_SeekableStream{ dynamic_cast<Cafe::Io::SeekableStreamBase*>(stream) }
+{
+	assert(m_SeekableStream && "stream should be seekable.");
+	m_SeekableStream->SeekFromBegin(0);
+
+	Cafe::Io::BinaryReader reader{ stream, std::endian::big };
+	while (stream->GetAvailableBytes() >= 4)
+	{
+		const auto cmd = *reader.Read<std::uint16_t>();
+		const auto bodySize = *reader.Read<std::uint16_t>();
+		if (stream->GetAvailableBytes() < bodySize)
+		{
+			break;
+		}
+
+		m_Entries.push_back({ cmd, bodySize, m_SeekableStream->GetPosition() });
+		m_SeekableStream->Seek(Cafe::Io::SeekOrigin::Current, bodySize);
+	}
+
+	BuildIndex();
+}
+
+gsl::span<const std::byte> TlvReader::GetBody(Entry const& entry)
+{
+	if (!m_Stream)
+	{
+		return m_Data.subspan(entry.BodyOffset, entry.BodySize);
+	}
+
+	m_SeekableStream->SeekFromBegin(entry.BodyOffset);
+	m_BodyBuffer.resize(entry.BodySize);
+	m_Stream->ReadBytes(gsl::make_span(m_BodyBuffer));
+	return m_BodyBuffer;
+}
+
+void TlvReader::BuildIndex()
 {
-	assert(dynamic_cast<Cafe::Io::SeekableStreamBase*>(stream) && "stream should be seekable.");
+	const auto entryCount = m_Entries.size();
+	m_NextIndexes.assign(entryCount, static_cast<std::uint32_t>(entryCount));
+
+	// 保持装载因子不超过 1/2
+	std::size_t bucketCount = 8;
+	while (bucketCount < entryCount * 2)
+	{
+		bucketCount *= 2;
+	}
+	m_Buckets.assign(bucketCount, 0);
+
+	// 与 m_Buckets 对应，每个 Cmd 当前的最后一个 Tlv 的下标
+	std::vector<std::uint32_t> lastIndexes(bucketCount);
+	for (std::size_t i = 0; i < entryCount; ++i)
+	{
+		const auto bucketIndex = GetBucketIndex(m_Entries[i].Cmd);
+		auto& bucket = m_Buckets[bucketIndex];
+		if (bucket)
+		{
+			m_NextIndexes[lastIndexes[bucketIndex]] = static_cast<std::uint32_t>(i);
+		}
+		else
+		{
+			bucket = static_cast<std::uint32_t>(i + 1);
+		}
+		lastIndexes[bucketIndex] = static_cast<std::uint32_t>(i);
+	}
+}
+
+gsl::span<const TlvReader::Entry> TlvReader::GetEntries() const noexcept
+{
+	return m_Entries;
+}
+
+TlvReader::Entry const* TlvReader::FindEntry(std::uint16_t cmd) const noexcept
+{
+	const auto bucket = m_Buckets[GetBucketIndex(cmd)];
+	return bucket ? &m_Entries[bucket - 1] : nullptr;
+}
+
+TlvReader::Entry const* TlvReader::FindNextEntry(Entry const& entry) const noexcept
+{
+	const auto index = static_cast<std::size_t>(&entry - m_Entries.data());
+	assert(index < m_Entries.size());
+	const auto nextIndex = m_NextIndexes[index];
+	return nextIndex < m_Entries.size() ? &m_Entries[nextIndex] : nullptr;
+}
+
+std::size_t TlvReader::GetBucketIndex(std::uint16_t cmd) const noexcept
+{
+	// 返回 cmd 所在的位置，不存在时返回应当插入的空位
+	const auto mask = m_Buckets.size() - 1;
+	for (auto index = (cmd * std::size_t{ 0x9E3779B1 } >> 8) & mask;;
+	     index = (index + 1) & mask)
+	{
+		const auto bucket = m_Buckets[index];
+		if (!bucket || m_Entries[bucket - 1].Cmd == cmd)
+		{
+			return index;
+		}
+	}
+}
+
+TlvResponse::TlvResponse(std::vector<std::byte> data)
+    : m_Data{ std::move(data) }, m_Reader{ gsl::make_span(m_Data) }
+{
+}
+
+TlvReader& TlvResponse::GetReader() noexcept
+{
+	return m_Reader;
+}
+
+TlvReader* TlvResponse::GetNested(std::uint16_t cmd, Cryptography::Tea::TeaContext const& key)
+{
+	for (const auto& nestedReader : m_NestedReaders)
+	{
+		if (nestedReader.Cmd == cmd)
+		{
+			return nestedReader.Reader.get();
+		}
+	}
+
+	const auto entry = m_Reader.FindEntry(cmd);
+	if (!entry)
+	{
+		return nullptr;
+	}
+
+	// 明文不会长于密文
+	const auto container = m_Reader.GetBody(*entry);
+	std::vector<std::byte> body(static_cast<std::size_t>(container.size()));
+	body.resize(key.Decrypt(container, body));
+	if (body.size() < 2)
+	{
+		CAFE_THROW(TlvDecodeException, CAFE_UTF8_SV("Nested tlv container is too short."));
+	}
+
+	auto reader = std::make_unique<TlvReader>(gsl::make_span(body).subspan(2));
+	const auto result = reader.get();
+	m_NestedReaders.push_back({ cmd, std::move(body), std::move(reader) });
+	return result;
 }
@@ -1,38 +1,76 @@
 ﻿#pragma once
+#include "Buffer.h"
 #include "Cryptography.h"
 #include "Misc.h"
 #include <Cafe/Io/StreamHelpers/BinaryReader.h>
 #include <Cafe/Io/StreamHelpers/BinaryWriter.h>
+#include <Cafe/ErrorHandling/ErrorHandling.h>
 #include <Cafe/Io/Streams/MemoryStream.h>
-#include <random>
+#include <array>
+#include <memory>
 
 namespace YumeBot::Tlv
 {
+	CAFE_DEFINE_GENERAL_EXCEPTION(TlvDecodeException);
+
 	/// @brief  表示指定 Cmd 的 Tlv
-	/// @remark 若 Tlv 具有读取的能力，应当自行管理生命周期问题
-	///         即若 Tlv 不需要读取，可以全部使用视图而不是容器保存自身的值
+	/// @remark Tlv 使用视图而不是容器保存自身的值
+	///         读取得到的 Tlv 中的视图直接指向 Body，其生命周期由 Body 的持有者（如 TlvResponse）管理
 	template <std::uint16_t Cmd>
 	struct TlvT
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
-		{
-		}
+	};
 
-		static TlvT<Cmd> Read(Cafe::Io::BinaryReader& reader, std::size_t bodySize)
-		{
-			return {};
-		}
+	/// @brief  Tlv 是否具有固定的大小及布局
+	/// @remark 这样的 Tlv 应定义 static constexpr std::size_t BodySize 及
+	///         void WritePacked(std::byte* body) const，后者以大端序将 Body 写入 body 起始的
+	///         BodySize 个字节
+	///         TlvBuilder 将预留整个 Tlv 的空间并直接写入，不经过 BinaryWriter
+	template <std::uint16_t Cmd, typename = void>
+	struct IsPackedTlvTrait : std::false_type
+	{
+	};
+
+	template <std::uint16_t Cmd>
+	struct IsPackedTlvTrait<Cmd, std::void_t<decltype(TlvT<Cmd>::BodySize),
+	                                         decltype(std::declval<TlvT<Cmd> const&>().WritePacked(
+	                                             std::declval<std::byte*>()))>> : std::true_type
+	{
 	};
 
+	template <std::uint16_t Cmd>
+	constexpr bool IsPackedTlv = IsPackedTlvTrait<Cmd>::value;
+
+	class TlvBuilder;
+
+	/// @brief  Tlv 是否为加密的 Tlv 容器
+	/// @remark 这样的 Tlv 应定义 void WriteInnerTlvs(TlvBuilder& builder) const 及以格式化密钥表示的
+	///         Key，Body 为以 Key 加密的 2 字节大端序的内部 Tlv 数量及内部 Tlv
+	///         TlvBuilder 将内部 Tlv 直接写入外层的缓冲区并就地加密
 	template <std::uint16_t Cmd, typename = void>
-	struct IsWritableTlvTrait : std::false_type
+	struct IsEncryptedTlvContainerTrait : std::false_type
 	{
 	};
 
 	template <std::uint16_t Cmd>
-	struct IsWritableTlvTrait<
-	    Cmd, std::void_t<decltype(TlvT<Cmd>::Write(std::declval<Cafe::Io::BinaryWriter&>()))>>
-	    : std::true_type
+	struct IsEncryptedTlvContainerTrait<
+	    Cmd, std::void_t<decltype(TlvT<Cmd>::Key),
+	                     decltype(std::declval<TlvT<Cmd> const&>().WriteInnerTlvs(
+	                         std::declval<TlvBuilder&>()))>> : std::true_type
+	{
+	};
+
+	template <std::uint16_t Cmd>
+	constexpr bool IsEncryptedTlvContainer = IsEncryptedTlvContainerTrait<Cmd>::value;
+
+	template <std::uint16_t Cmd, typename = void>
+	struct IsWritableTlvTrait : std::bool_constant<IsPackedTlv<Cmd> || IsEncryptedTlvContainer<Cmd>>
+	{
+	};
+
+	template <std::uint16_t Cmd>
+	struct IsWritableTlvTrait<Cmd, std::void_t<decltype(std::declval<TlvT<Cmd> const&>().Write(
+	                                   std::declval<Cafe::Io::BinaryWriter&>()))>> : std::true_type
 	{
 	};
 
@@ -44,80 +82,284 @@ namespace YumeBot::Tlv
 	{
 	};
 
+	/// @remark 可读取的 Tlv 应定义 static TlvT<Cmd> Read(gsl::span<const std::byte> const& body)
 	template <std::uint16_t Cmd>
 	struct IsReadableTlvTrait<
-	    Cmd, std::void_t<decltype(TlvT<Cmd>::Read(std::declval<Cafe::Io::BinaryReader&>(),
-	                                              std::declval<std::size_t>()))>> : std::true_type
+	    Cmd,
+	    std::void_t<decltype(TlvT<Cmd>::Read(std::declval<gsl::span<const std::byte> const&>()))>>
+	    : std::true_type
 	{
 	};
 
 	template <std::uint16_t Cmd>
 	constexpr bool IsReadableTlv = IsReadableTlvTrait<Cmd>::value;
 
+	/// @brief  所有可读取的 Tlv 的 Cmd，DispatchTlv 以此生成分派表
+	/// @remark 新增可读取的 TlvT 时必须加入此列表，否则以 TlvReader 读取或分派 Tlv 时将无法编译
+	using ReadableTlvCmds =
+	    std::integer_sequence<std::uint16_t, 0x103, 0x104, 0x108, 0x10A, 0x10C, 0x10D, 0x10E, 0x114,
+	                          0x11A, 0x120, 0x133, 0x134, 0x136, 0x143, 0x146, 0x16A, 0x203, 0x305,
+	                          0x322>;
+
+	namespace Detail
+	{
+		template <std::uint16_t Cmd, std::uint16_t... Cmds>
+		constexpr bool Contains(std::integer_sequence<std::uint16_t, Cmds...>) noexcept
+		{
+			return ((Cmd == Cmds) || ...);
+		}
+	} // namespace Detail
+
+	template <std::uint16_t Cmd>
+	constexpr bool IsListedReadableTlv = Detail::Contains<Cmd>(ReadableTlvCmds{});
+
+	/// @brief  顺序读取 Tlv 的 Body，取得的视图直接指向 Body
+	/// @remark 剩余的字节不足时抛出 TlvDecodeException
+	class BodyReader
+	{
+	public:
+		explicit BodyReader(gsl::span<const std::byte> const& body) noexcept;
+
+		/// @brief  以大端序读取整数
+		template <typename T>
+		T Read()
+		{
+			return Utility::LoadBigEndian<T>(ReadBytes(sizeof(T)).data());
+		}
+
+		gsl::span<const std::byte> ReadBytes(std::size_t size);
+
+		/// @brief  读取以 SizeType 类型的大端序长度为前缀的字节
+		template <typename SizeType>
+		gsl::span<const std::byte> ReadSizedBytes()
+		{
+			return ReadBytes(Read<SizeType>());
+		}
+
+		/// @brief  读取以 SizeType 类型的大端序长度为前缀的字符串
+		template <typename SizeType>
+		UsingStringView ReadSizedString()
+		{
+			return AsStringView(ReadSizedBytes<SizeType>());
+		}
+
+		/// @brief  读取剩余的所有字节
+		gsl::span<const std::byte> ReadRemaining() noexcept;
+
+	private:
+		gsl::span<const std::byte> m_Body;
+	};
+
+	/// @brief  预先编码的若干 Tlv
+	struct EncodedTlvBlock
+	{
+		std::vector<std::byte> Data;
+		std::size_t TlvCount;
+	};
+
+	/// @brief  在连续的缓冲区中写入 Tlv
+	/// @remark 写入 Body 之后直接在缓冲区中填写长度，不需要定位流
+	///         具有固定大小及布局的 Tlv 将一次预留空间并直接写入
 	class TlvBuilder
 	{
 	public:
-		explicit TlvBuilder(Cafe::Io::OutputStream* stream, std::size_t initialTlvCount = 0);
+		explicit TlvBuilder(Buffer& buffer, std::size_t initialTlvCount = 0);
 
 		template <std::uint16_t Cmd>
 		void WriteTlv(TlvT<Cmd> const& tlv)
 		{
-			const auto seekableStream = dynamic_cast<Cafe::Io::SeekableStreamBase*>(m_Writer.GetStream());
-			assert(seekableStream);
+			static_assert(IsWritableTlv<Cmd>, "Tlv should be writable.");
 
-			m_Writer.Write(Cmd);
-			const auto lengthPos = seekableStream->GetPosition();
-			m_Writer.Write(std::uint16_t{});
+			if constexpr (IsEncryptedTlvContainer<Cmd>)
+			{
+				WriteEncryptedTlv(Cmd, Cryptography::Tea::TeaContext{ tlv.Key },
+				                  [&](TlvBuilder& innerBuilder) { tlv.WriteInnerTlvs(innerBuilder); });
+				return;
+			}
+			else if constexpr (IsPackedTlv<Cmd>)
+			{
+				constexpr std::size_t bodySize = TlvT<Cmd>::BodySize;
+				static_assert(bodySize <= std::numeric_limits<std::uint16_t>::max());
 
-			tlv.Write(m_Writer);
+				const auto header = m_Buffer.Append(4 + bodySize).data();
+				WriteHeader(header, Cmd, bodySize);
+				tlv.WritePacked(header + 4);
+			}
+			else
+			{
+				const auto headerOffset = m_Buffer.GetSize();
+				m_Buffer.Append(4);
+				tlv.Write(m_Writer);
 
-			const auto length = seekableStream->GetPosition() - lengthPos - 2;
-			assert(length <= std::numeric_limits<std::uint16_t>::max());
-			seekableStream->SeekFromBegin(lengthPos);
-			m_Writer.Write(static_cast<std::uint16_t>(length));
+				const auto bodySize = m_Buffer.GetSize() - headerOffset - 4;
+				assert(bodySize <= std::numeric_limits<std::uint16_t>::max());
+				WriteHeader(m_Buffer.GetData() + headerOffset, Cmd, bodySize);
+			}
 
 			++m_TlvCount;
 		}
 
+		/// @brief  写入以 key 加密的 Tlv 容器
+		/// @remark writeInnerTlvs 以 TlvBuilder& 为参数，写入的内部 Tlv 直接编码在当前缓冲区中，
+		///         之后就地加密并填写内部 Tlv 的数量及外层 Tlv 的长度，不使用额外的缓冲区
+		template <typename Func>
+		void WriteEncryptedTlv(std::uint16_t cmd, Cryptography::Tea::TeaContext const& key,
+		                       Func&& writeInnerTlvs)
+		{
+			const auto headerOffset = BeginEncryptedTlv();
+			TlvBuilder innerBuilder{ m_Buffer };
+			std::invoke(writeInnerTlvs, innerBuilder);
+			EndEncryptedTlv(headerOffset, cmd, key, innerBuilder.GetTlvCount());
+		}
+
+		/// @brief  直接复制预先编码的 Tlv
+		void WriteEncoded(EncodedTlvBlock const& block);
+
 		std::size_t GetTlvCount() const noexcept;
 
+		Buffer& GetBuffer() const noexcept;
+
 	private:
+		Buffer& m_Buffer;
 		Cafe::Io::BinaryWriter m_Writer;
 		std::size_t m_TlvCount;
+
+		static void WriteHeader(std::byte* header, std::uint16_t cmd, std::size_t bodySize) noexcept;
+
+		/// @brief  预留外层 Tlv 的头部及内部 Tlv 的数量
+		/// @return 外层 Tlv 的头部在缓冲区中的位置
+		std::size_t BeginEncryptedTlv();
+		void EndEncryptedTlv(std::size_t headerOffset, std::uint16_t cmd,
+		                     Cryptography::Tea::TeaContext const& key, std::size_t innerTlvCount);
 	};
 
 	class TlvReader
 	{
 	public:
+		/// @brief  Tlv 在流中的位置
+		struct Entry
+		{
+			std::uint16_t Cmd;
+			std::uint16_t BodySize;
+			/// @brief  Body 在流中的起始位置
+			std::size_t BodyOffset;
+		};
+
+		/// @remark 构造时遍历一次数据并建立索引，之后的读取将直接定位到对应的 Tlv
+		///         Body 的大小超出剩余部分时，将忽略该 Tlv 及其后的内容
+		///         读取的 Tlv 中的视图直接指向 data，不复制 Body
+		explicit TlvReader(gsl::span<const std::byte> const& data);
+
+		/// @remark 每次读取时将 Body 复制到内部的缓冲区中，读取的 Tlv 中的视图仅在下次读取前有效
+		///         流的内容在 TlvReader 的生命周期内不应改变
 		explicit TlvReader(Cafe::Io::InputStream* stream);
 
+		/// @brief  按照在流中的顺序获得所有 Tlv 的位置
+		gsl::span<const Entry> GetEntries() const noexcept;
+
+		/// @brief  查找指定 Cmd 的第一个 Tlv
+		/// @return 不存在时返回 nullptr
+		Entry const* FindEntry(std::uint16_t cmd) const noexcept;
+
+		/// @brief  查找与 entry 具有相同 Cmd 的下一个 Tlv
+		/// @param  entry 应为 GetEntries() 中的元素
+		/// @return 不存在时返回 nullptr
+		Entry const* FindNextEntry(Entry const& entry) const noexcept;
+
+		/// @brief  取得 entry 的 Body
+		/// @param  entry 应为 GetEntries() 中的元素
+		gsl::span<const std::byte> GetBody(Entry const& entry);
+
 		template <std::uint16_t Cmd>
-		std::optional<TlvT<Cmd>> ReadTlv()
+		TlvT<Cmd> ReadTlv(Entry const& entry)
 		{
-			const auto stream = m_Reader.GetStream();
-			const auto seekableStream = dynamic_cast<Cafe::Io::SeekableStreamBase*>(stream);
-			assert(seekableStream);
-			seekableStream->SeekFromBegin(0);
+			static_assert(IsReadableTlv<Cmd>, "Tlv should be readable.");
+			static_assert(IsListedReadableTlv<Cmd>, "Readable Tlv should be listed in ReadableTlvCmds.");
+			assert(entry.Cmd == Cmd);
+			return TlvT<Cmd>::Read(GetBody(entry));
+		}
 
-			while (stream->GetAvailableBytes() > 4)
+		/// @brief  读取指定 Cmd 的第一个 Tlv
+		template <std::uint16_t Cmd>
+		std::optional<TlvT<Cmd>> ReadTlv()
+		{
+			if (const auto entry = FindEntry(Cmd))
 			{
-				const auto cmd = *m_Reader.Read<std::uint16_t>();
-				const auto bodySize = *m_Reader.Read<std::uint16_t>();
-				if (cmd == Cmd)
-				{
-					return TlvT<Cmd>::Read(m_Reader, bodySize);
-				}
-				else
-				{
-					seekableStream->Seek(Cafe::Io::SeekOrigin::Current, bodySize);
-				}
+				return ReadTlv<Cmd>(*entry);
 			}
 
 			return {};
 		}
 
+		/// @brief  按照在流中的顺序读取所有指定 Cmd 的 Tlv，并依次传入 receiver
+		/// @return 读取的 Tlv 的数量
+		template <std::uint16_t Cmd, typename Receiver>
+		std::size_t ReadAllTlv(Receiver&& receiver)
+		{
+			std::size_t count = 0;
+			for (auto entry = FindEntry(Cmd); entry; entry = FindNextEntry(*entry))
+			{
+				std::invoke(receiver, ReadTlv<Cmd>(*entry));
+				++count;
+			}
+
+			return count;
+		}
+
+	private:
+		gsl::span<const std::byte> m_Data;
+		/// @brief  以流构造时不为 nullptr
+		Cafe::Io::InputStream* m_Stream;
+		Cafe::Io::SeekableStreamBase* m_SeekableStream;
+		std::vector<std::byte> m_BodyBuffer;
+		std::vector<Entry> m_Entries;
+		/// @brief  与 m_Entries 对应，具有相同 Cmd 的下一个 Tlv 的下标，不存在时为 m_Entries.size()
+		std::vector<std::uint32_t> m_NextIndexes;
+		/// @brief  开放寻址的散列表，保存每个 Cmd 的第一个 Tlv 的下标加 1，为 0 表示空位
+		std::vector<std::uint32_t> m_Buckets;
+
+		void BuildIndex();
+		std::size_t GetBucketIndex(std::uint16_t cmd) const noexcept;
+	};
+
+	/// @brief  持有解密后的响应，读取的 Tlv 中的视图均指向本对象持有的数据
+	class TlvResponse
+	{
+	public:
+		/// @param  data 解密后的 Tlv 序列
+		explicit TlvResponse(std::vector<std::byte> data);
+
+		TlvResponse(TlvResponse const&) = delete;
+		TlvResponse& operator=(TlvResponse const&) = delete;
+
+		TlvReader& GetReader() noexcept;
+
+		template <std::uint16_t Cmd>
+		std::optional<TlvT<Cmd>> ReadTlv()
+		{
+			return m_Reader.ReadTlv<Cmd>();
+		}
+
+		/// @brief  取得以 key 加密的 Tlv 容器中的内部 Tlv
+		/// @remark 容器的 Body 解密后为 2 字节大端序的内部 Tlv 数量及内部 Tlv
+		///         首次访问时解密到本对象持有的独立缓冲区并建立索引，之后直接返回相同的结果
+		///         不会修改容器本身，解密失败时抛出异常，之后仍可以其他密钥重试或由 GetReader() 读取
+		/// @return 不存在该 Tlv 时返回 nullptr
+		TlvReader* GetNested(std::uint16_t cmd, Cryptography::Tea::TeaContext const& key);
+
 	private:
-		Cafe::Io::BinaryReader m_Reader;
+		struct NestedReader
+		{
+			std::uint16_t Cmd;
+			/// @brief  解密后的 Body，移动时其中的数据不会移动，因此 Reader 中的视图保持有效
+			std::vector<std::byte> Data;
+			/// @brief  使得返回的指针在之后的访问中保持有效
+			std::unique_ptr<TlvReader> Reader;
+		};
+
+		std::vector<std::byte> m_Data;
+		TlvReader m_Reader;
+		std::vector<NestedReader> m_NestedReaders;
 	};
 
 	template <>
@@ -165,11 +407,12 @@ namespace YumeBot::Tlv
 	template <>
 	struct TlvT<0x8>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 8;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(TimeZoneVer);
-			writer.Write(static_cast<std::uint32_t>(LocaleId));
-			writer.Write(TimeZoneOffset);
+			Utility::PackBigEndian(body, TimeZoneVer, static_cast<std::uint32_t>(LocaleId),
+			                        TimeZoneOffset);
 		}
 
 		std::uint16_t TimeZoneVer = 0;
@@ -182,16 +425,12 @@ namespace YumeBot::Tlv
 	{
 		static constexpr std::uint16_t PingVersion = 1;
 		static constexpr std::uint32_t SsoVersion = 0x0600;
+		static constexpr std::size_t BodySize = 22;
 
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(PingVersion);
-			writer.Write(SsoVersion);
-			writer.Write(AppId);
-			writer.Write(ClientVersion);
-			writer.Write(Uin);
-			writer.Write(Rc);
-			writer.Write(std::uint16_t{});
+			Utility::PackBigEndian(body, PingVersion, SsoVersion, AppId, ClientVersion, Uin, Rc,
+			                        std::uint16_t{});
 		}
 
 		std::uint32_t AppId;
@@ -205,15 +444,11 @@ namespace YumeBot::Tlv
 	{
 		static constexpr std::uint16_t DbBufVer = 1;
 		static constexpr std::uint32_t SsoVer = 5;
+		static constexpr std::size_t BodySize = 22;
 
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(DbBufVer);
-			writer.Write(SsoVer);
-			writer.Write(AppId);
-			writer.Write(WxAppId);
-			writer.Write(ClientVer);
-			writer.Write(GetSig);
+			Utility::PackBigEndian(body, DbBufVer, SsoVer, AppId, WxAppId, ClientVer, GetSig);
 		}
 
 		std::uint32_t AppId;
@@ -222,6 +457,17 @@ namespace YumeBot::Tlv
 		std::uint32_t GetSig;
 	};
 
+	template <>
+	struct TlvT<0x103>
+	{
+		static TlvT<0x103> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> StWebSig;
+	};
+
 	template <>
 	struct TlvT<0x104>
 	{
@@ -230,6 +476,11 @@ namespace YumeBot::Tlv
 			writer.GetStream()->WriteBytes(SigSession);
 		}
 
+		static TlvT<0x104> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
 		gsl::span<const std::byte> SigSession;
 	};
 
@@ -247,11 +498,8 @@ namespace YumeBot::Tlv
 
 			unencryptedBodyWriter.Write(TGTGTVer);
 
-			std::default_random_engine ran{ std::random_device{}() };
-			std::uniform_int_distribution<std::uint32_t> dist{ 0,
-				                                                 std::numeric_limits<std::int32_t>::max() };
-
-			unencryptedBodyWriter.Write(dist(ran));
+			// 取值范围为 [0, std::numeric_limits<std::int32_t>::max()]
+			unencryptedBodyWriter.Write(Cryptography::Random::NextUInt32() & 0x7FFFFFFF);
 
 			unencryptedBodyWriter.Write(SsoVer);
 			unencryptedBodyWriter.Write(AppId);
@@ -270,11 +518,9 @@ namespace YumeBot::Tlv
 
 			if (Guid.empty())
 			{
-				std::uniform_int_distribution<std::uint32_t> dist{};
-				for (std::size_t i = 0; i < 4; ++i)
-				{
-					unencryptedBodyWriter.Write(dist(ran));
-				}
+				std::byte randomGuid[16];
+				Cryptography::Random::Fill(randomGuid);
+				unencryptedBodyStream.WriteBytes(gsl::make_span(randomGuid));
 			}
 			else
 			{
@@ -284,32 +530,40 @@ namespace YumeBot::Tlv
 			unencryptedBodyWriter.Write(SubAppId);
 			unencryptedBodyWriter.Write(SigSrc);
 
-			std::byte encryptKeyContent[24];
-			Cafe::Io::ExternalMemoryOutputStream encryptKeyStream{ gsl::make_span(encryptKeyContent) };
-			Cafe::Io::BinaryWriter encryptKeyWriter{ &encryptKeyStream, std::endian::big };
-
-			encryptKeyStream.WriteBytes(Md5);
-			if (MSalt)
-			{
-				encryptKeyWriter.Write(MSalt);
-			}
-			else
-			{
-				encryptKeyWriter.Write(Uin);
-			}
-
-			std::uint32_t encryptKey[4];
-			Cryptography::Md5::Calculate(gsl::make_span(encryptKeyContent),
-			                             gsl::as_writeable_bytes(gsl::make_span(encryptKey)));
-
 			std::byte encryptedBody[Cryptography::Tea::CalculateOutputSize(std::size(unencryptedBody))];
-			const auto size =
-			    Cryptography::Tea::Encrypt(gsl::make_span(unencryptedBody), gsl::make_span(encryptedBody),
-			                               gsl::make_span(encryptKey));
+			const auto size = [&] {
+				if (PreparedKey)
+				{
+					return PreparedKey->Encrypt(gsl::make_span(unencryptedBody),
+					                            gsl::make_span(encryptedBody));
+				}
+
+				const auto encryptKey = CalculateEncryptKey(Md5, MSalt, Uin);
+				return Cryptography::Tea::Encrypt(gsl::make_span(unencryptedBody),
+				                                  gsl::make_span(encryptedBody), encryptKey);
+			}();
 
 			writer.GetStream()->WriteBytes(gsl::make_span(encryptedBody, size));
 		}
 
+		/// @brief  计算加密使用的密钥
+		/// @remark 密钥为 md5 与 8 字节大端序的 mSalt 的 MD5，mSalt 为 0 时以 uin 代替
+		static std::array<std::uint32_t, 4>
+		CalculateEncryptKey(gsl::span<const std::byte, 16> const& md5, std::uint64_t mSalt,
+		                    std::uint64_t uin)
+		{
+			std::byte salt[8];
+			Cafe::Io::ExternalMemoryOutputStream saltStream{ gsl::make_span(salt) };
+			Cafe::Io::BinaryWriter{ &saltStream, std::endian::big }.Write(mSalt ? mSalt : uin);
+
+			Cryptography::Md5::Context md5Context;
+			md5Context.Update(md5);
+			md5Context.Update(gsl::make_span(salt));
+			std::array<std::uint32_t, 4> encryptKey;
+			md5Context.Final(gsl::as_writeable_bytes(gsl::make_span(encryptKey)));
+			return encryptKey;
+		}
+
 		std::uint32_t AppId;
 		std::uint32_t SubAppId;
 		std::uint32_t ClientVer;
@@ -323,17 +577,18 @@ namespace YumeBot::Tlv
 		bool ReadFlg;
 		gsl::span<const std::byte, 16> Guid;
 		std::uint32_t SigSrc;
+		/// @brief  预先准备的密钥，不为 nullptr 时不再由 Md5、MSalt 及 Uin 计算密钥
+		Cryptography::Tea::TeaContext const* PreparedKey = nullptr;
 	};
 
 	template <>
 	struct TlvT<0x107>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 6;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(PicType);
-			writer.Write(CapType);
-			writer.Write(PicSize);
-			writer.Write(RetType);
+			Utility::PackBigEndian(body, PicType, CapType, PicSize, RetType);
 		}
 
 		std::uint16_t PicType;
@@ -347,17 +602,15 @@ namespace YumeBot::Tlv
 	{
 		void Write(Cafe::Io::BinaryWriter& writer) const
 		{
-			writer.GetStream()->WriteBytes(gsl::make_span(Ksid));
+			writer.GetStream()->WriteBytes(Ksid);
 		}
 
-		static TlvT<0x108> Read(Cafe::Io::BinaryReader& reader, std::size_t bodySize)
+		static TlvT<0x108> Read(gsl::span<const std::byte> const& body)
 		{
-			TlvT<0x108> tlv{ std::vector<std::byte>(bodySize) };
-			reader.GetStream()->ReadBytes(gsl::make_span(tlv.Ksid));
-			return tlv;
+			return { body };
 		}
 
-		std::vector<std::byte> Ksid;
+		gsl::span<const std::byte> Ksid;
 	};
 
 	template <>
@@ -380,9 +633,47 @@ namespace YumeBot::Tlv
 			writer.GetStream()->WriteBytes(TGT);
 		}
 
+		static TlvT<0x10A> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
 		gsl::span<const std::byte> TGT;
 	};
 
+	template <>
+	struct TlvT<0x10C>
+	{
+		static TlvT<0x10C> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> GtKey;
+	};
+
+	template <>
+	struct TlvT<0x10D>
+	{
+		static TlvT<0x10D> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> TgtKey;
+	};
+
+	template <>
+	struct TlvT<0x10E>
+	{
+		static TlvT<0x10E> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> StKey;
+	};
+
 	template <>
 	struct TlvT<0x112>
 	{
@@ -394,6 +685,17 @@ namespace YumeBot::Tlv
 		UsingStringView Name;
 	};
 
+	template <>
+	struct TlvT<0x114>
+	{
+		static TlvT<0x114> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> St;
+	};
+
 	template <>
 	struct TlvT<0x116>
 	{
@@ -418,6 +720,36 @@ namespace YumeBot::Tlv
 		gsl::span<const std::uint32_t> AppId;
 	};
 
+	template <>
+	struct TlvT<0x11A>
+	{
+		static TlvT<0x11A> Read(gsl::span<const std::byte> const& body)
+		{
+			BodyReader reader{ body };
+			const auto face = reader.Read<std::uint16_t>();
+			const auto age = reader.Read<std::uint8_t>();
+			const auto gender = reader.Read<std::uint8_t>();
+			const auto nick = reader.ReadSizedString<std::uint8_t>();
+			return { face, age, gender, nick };
+		}
+
+		std::uint16_t Face;
+		std::uint8_t Age;
+		std::uint8_t Gender;
+		UsingStringView Nick;
+	};
+
+	template <>
+	struct TlvT<0x120>
+	{
+		static TlvT<0x120> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> SKey;
+	};
+
 	template <>
 	struct TlvT<0x124>
 	{
@@ -531,6 +863,39 @@ namespace YumeBot::Tlv
 		UsingStringView Brand;
 	};
 
+	template <>
+	struct TlvT<0x133>
+	{
+		static TlvT<0x133> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> WtSessionTicket;
+	};
+
+	template <>
+	struct TlvT<0x134>
+	{
+		static TlvT<0x134> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> WtSessionTicketKey;
+	};
+
+	template <>
+	struct TlvT<0x136>
+	{
+		static TlvT<0x136> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> VKey;
+	};
+
 	template <>
 	struct TlvT<0x141>
 	{
@@ -591,54 +956,46 @@ namespace YumeBot::Tlv
 			writer.GetStream()->WriteBytes(B);
 		}
 
+		static TlvT<0x143> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
 		gsl::span<const std::byte> B;
 	};
 
 	template <>
-	struct TlvT<0x144>
+	struct TlvT<0x145>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 16;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			const std::uint16_t tlvCount = !_109.empty() + !_124.empty() + !_128.empty() + !_148.empty() +
-			                               !_151.empty() + !_153.empty() + !_16e.empty();
-			Cafe::Io::MemoryStream unencryptedDataStream;
-			Cafe::Io::BinaryWriter unencryptedDataWriter{ &unencryptedDataStream, std::endian::big };
-			unencryptedDataWriter.Write(tlvCount);
-			unencryptedDataStream.WriteBytes(_109);
-			unencryptedDataStream.WriteBytes(_124);
-			unencryptedDataStream.WriteBytes(_128);
-			unencryptedDataStream.WriteBytes(_148);
-			unencryptedDataStream.WriteBytes(_151);
-			unencryptedDataStream.WriteBytes(_153);
-			unencryptedDataStream.WriteBytes(_16e);
-
-			std::vector<std::byte> encrypedData(
-			    Cryptography::Tea::CalculateOutputSize(unencryptedDataStream.GetTotalSize()));
-			const auto size = Cryptography::Tea::Encrypt(unencryptedDataStream.GetInternalStorage(),
-			                                             gsl::make_span(encrypedData), Key);
-
-			writer.GetStream()->WriteBytes(gsl::make_span(encrypedData.data(), size));
-		}
-
-		gsl::span<const std::byte> _109;
-		gsl::span<const std::byte> _124;
-		gsl::span<const std::byte> _128;
-		gsl::span<const std::byte> _148;
-		gsl::span<const std::byte> _151;
-		gsl::span<const std::byte> _153;
-		gsl::span<const std::byte> _16e;
-		gsl::span<const std::uint32_t, 4> Key;
+			std::memcpy(body, Guid.data(), BodySize);
+		}
+
+		gsl::span<const std::byte, 16> Guid;
 	};
 
 	template <>
-	struct TlvT<0x145>
+	struct TlvT<0x146>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static TlvT<0x146> Read(gsl::span<const std::byte> const& body)
 		{
-			writer.GetStream()->WriteBytes(Guid);
+			BodyReader reader{ body };
+			const auto ver = reader.Read<std::uint16_t>();
+			const auto code = reader.Read<std::uint16_t>();
+			const auto title = reader.ReadSizedString<std::uint16_t>();
+			const auto message = reader.ReadSizedString<std::uint16_t>();
+			const auto errorInfo = reader.ReadSizedString<std::uint16_t>();
+			return { ver, code, title, message, errorInfo };
 		}
 
-		gsl::span<const std::byte, 16> Guid;
+		std::uint16_t Ver;
+		std::uint16_t Code;
+		UsingStringView Title;
+		UsingStringView Message;
+		UsingStringView ErrorInfo;
 	};
 
 	template <>
@@ -704,11 +1061,24 @@ namespace YumeBot::Tlv
 	};
 
 	template <>
-	struct TlvT<0x153>
+	struct TlvT<0x151>
 	{
 		void Write(Cafe::Io::BinaryWriter& writer) const
 		{
-			writer.Write(IsRoot);
+			writer.GetStream()->WriteBytes(Data);
+		}
+
+		gsl::span<const std::byte> Data;
+	};
+
+	template <>
+	struct TlvT<0x153>
+	{
+		static constexpr std::size_t BodySize = 2;
+
+		void WritePacked(std::byte* body) const noexcept
+		{
+			Utility::PackBigEndian(body, IsRoot);
 		}
 
 		std::uint16_t IsRoot;
@@ -717,9 +1087,11 @@ namespace YumeBot::Tlv
 	template <>
 	struct TlvT<0x154>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 4;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(SsoSeq);
+			Utility::PackBigEndian(body, SsoSeq);
 		}
 
 		std::uint32_t SsoSeq;
@@ -728,9 +1100,11 @@ namespace YumeBot::Tlv
 	template <>
 	struct TlvT<0x166>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 1;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(ImgType);
+			Utility::PackBigEndian(body, ImgType);
 		}
 
 		std::uint8_t ImgType;
@@ -744,6 +1118,11 @@ namespace YumeBot::Tlv
 			writer.GetStream()->WriteBytes(NoPicSig);
 		}
 
+		static TlvT<0x16A> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
 		gsl::span<const std::byte> NoPicSig;
 	};
 
@@ -780,6 +1159,53 @@ namespace YumeBot::Tlv
 		UsingStringView DeviceName;
 	};
 
+	template <>
+	struct TlvT<0x144>
+	{
+		/// @brief  写入加密前的内部 Tlv
+		/// @remark 内部 Tlv 的类型需完整，因此定义于其后
+		void WriteInnerTlvs(TlvBuilder& builder) const
+		{
+			if (_109)
+			{
+				builder.WriteTlv(*_109);
+			}
+			if (_124)
+			{
+				builder.WriteTlv(*_124);
+			}
+			if (_128)
+			{
+				builder.WriteTlv(*_128);
+			}
+			if (_148)
+			{
+				builder.WriteTlv(*_148);
+			}
+			if (_151)
+			{
+				builder.WriteTlv(*_151);
+			}
+			if (_153)
+			{
+				builder.WriteTlv(*_153);
+			}
+			if (_16e)
+			{
+				builder.WriteTlv(*_16e);
+			}
+		}
+
+		std::optional<TlvT<0x109>> _109;
+		std::optional<TlvT<0x124>> _124;
+		std::optional<TlvT<0x128>> _128;
+		std::optional<TlvT<0x148>> _148;
+		std::optional<TlvT<0x151>> _151;
+		std::optional<TlvT<0x153>> _153;
+		std::optional<TlvT<0x16E>> _16e;
+		gsl::span<const std::uint32_t, 4> Key;
+	};
+
 	template <>
 	struct TlvT<0x172>
 	{
@@ -825,9 +1251,11 @@ namespace YumeBot::Tlv
 	template <>
 	struct TlvT<0x17A>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 4;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(SmsAppId);
+			Utility::PackBigEndian(body, SmsAppId);
 		}
 
 		std::uint32_t SmsAppId;
@@ -851,9 +1279,11 @@ namespace YumeBot::Tlv
 	template <>
 	struct TlvT<0x183>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 8;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(MSalt);
+			Utility::PackBigEndian(body, MSalt);
 		}
 
 		std::uint64_t MSalt;
@@ -862,20 +1292,32 @@ namespace YumeBot::Tlv
 	template <>
 	struct TlvT<0x184>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
-		{
-			const auto mPassword = gsl::as_bytes(MPassword.GetTrimmedSpan());
-
-			std::byte body[24];
-			Cryptography::Md5::Calculate(mPassword, gsl::make_span(body).subspan(0, 16));
-
-			Cafe::Io::ExternalMemoryOutputStream stream{ gsl::make_span(body) };
-			Cafe::Io::BinaryWriter{ &stream, std::endian::big }.Write(MSalt);
+		static constexpr std::size_t BodySize = 16;
 
-			std::byte md5Body[16];
-			Cryptography::Md5::Calculate(gsl::make_span(body), gsl::make_span(md5Body));
+		void WritePacked(std::byte* body) const
+		{
+			const auto md5Body = CalculateMd5Body(MPassword, MSalt);
+			std::memcpy(body, md5Body.data(), BodySize);
+		}
 
-			writer.GetStream()->WriteBytes(gsl::make_span(md5Body));
+		/// @brief  计算 MD5(MD5(mPassword) + 8 字节大端序的 mSalt)
+		static std::array<std::byte, 16> CalculateMd5Body(UsingStringView const& mPassword,
+		                                                  std::uint64_t mSalt)
+		{
+			Cryptography::Md5::Context md5Context;
+			std::byte passwordMd5[16];
+			md5Context.Update(gsl::as_bytes(mPassword.GetTrimmedSpan()));
+			md5Context.Final(gsl::make_span(passwordMd5));
+
+			std::byte salt[8];
+			Cafe::Io::ExternalMemoryOutputStream saltStream{ gsl::make_span(salt) };
+			Cafe::Io::BinaryWriter{ &saltStream, std::endian::big }.Write(mSalt);
+
+			std::array<std::byte, 16> md5Body;
+			md5Context.Update(gsl::make_span(passwordMd5));
+			md5Context.Update(gsl::make_span(salt));
+			md5Context.Final(md5Body);
+			return md5Body;
 		}
 
 		std::uint64_t MSalt;
@@ -885,10 +1327,11 @@ namespace YumeBot::Tlv
 	template <>
 	struct TlvT<0x185>
 	{
-		void Write(Cafe::Io::BinaryWriter& writer) const
+		static constexpr std::size_t BodySize = 2;
+
+		void WritePacked(std::byte* body) const noexcept
 		{
-			writer.Write(std::uint8_t{ 1 });
-			writer.Write(Flag);
+			Utility::PackBigEndian(body, std::uint8_t{ 1 }, Flag);
 		}
 
 		std::uint8_t Flag;
@@ -918,16 +1361,193 @@ namespace YumeBot::Tlv
 		UsingStringView AndroidID;
 	};
 
+	template <>
+	struct TlvT<0x203>
+	{
+		static TlvT<0x203> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> Da2;
+	};
+
 	template <>
 	struct TlvT<0x305>
 	{
-		static TlvT<0x305> Read(Cafe::Io::BinaryReader& reader, std::size_t bodySize)
+		static TlvT<0x305> Read(gsl::span<const std::byte> const& body)
+		{
+			return { body };
+		}
+
+		gsl::span<const std::byte> SessionKey;
+	};
+
+	template <>
+	struct TlvT<0x322>
+	{
+		static TlvT<0x322> Read(gsl::span<const std::byte> const& body)
 		{
-			TlvT<0x305> tlv{ std::vector<std::byte>(bodySize) };
-			reader.GetStream()->ReadBytes(gsl::make_span(tlv.SessionKey));
-			return tlv;
+			return { body };
 		}
 
-		std::vector<std::byte> SessionKey;
+		gsl::span<const std::byte> DeviceToken;
 	};
+
+	namespace Detail
+	{
+		template <std::uint16_t... Cmds>
+		constexpr bool AreReadableTlvs(std::integer_sequence<std::uint16_t, Cmds...>) noexcept
+		{
+			return (IsReadableTlv<Cmds> && ...);
+		}
+
+		template <std::uint16_t... Cmds>
+		constexpr bool AreStrictlyAscending(std::integer_sequence<std::uint16_t, Cmds...>) noexcept
+		{
+			constexpr std::uint16_t cmds[]{ Cmds... };
+			for (std::size_t i = 1; i < sizeof...(Cmds); ++i)
+			{
+				if (cmds[i - 1] >= cmds[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		static_assert(AreReadableTlvs(ReadableTlvCmds{}),
+		              "ReadableTlvCmds should only contain readable Tlvs.");
+		static_assert(AreStrictlyAscending(ReadableTlvCmds{}),
+		              "ReadableTlvCmds should be sorted and contain no duplicates.");
+
+		/// @brief  统计所有可能的 Cmd 中可读取的 Tlv 的数目
+		/// @remark 以数组初始化展开而不是折叠表达式，以免超出编译器的嵌套深度限制
+		template <std::size_t... Cmds>
+		constexpr std::size_t CountReadableTlvs(std::index_sequence<Cmds...>) noexcept
+		{
+			constexpr bool readable[]{ IsReadableTlv<static_cast<std::uint16_t>(Cmds)>... };
+			std::size_t count = 0;
+			for (const auto value : readable)
+			{
+				count += value;
+			}
+			return count;
+		}
+
+		/// @brief  列表中的 Cmd 均可读取且互不相同，因此数目相等即说明列表包含了所有可读取的 Tlv
+		/// @remark 需遍历全部 65536 个 Cmd，仅在生成分派表时求值，且每个列表只求值一次
+		template <typename CmdList>
+		constexpr bool IsCompleteReadableTlvList =
+		    CountReadableTlvs(std::make_index_sequence<0x10000>{}) == CmdList::size();
+
+		template <typename Handler, std::uint16_t Cmd>
+		void DecodeAndHandle(Handler& handler, gsl::span<const std::byte> const& body)
+		{
+			std::invoke(handler, TlvT<Cmd>::Read(body));
+		}
+
+		template <typename Handler, std::uint16_t Cmd>
+		constexpr auto GetDecodeFunction() noexcept
+		    -> void (*)(Handler& handler, gsl::span<const std::byte> const& body)
+		{
+			if constexpr (std::is_invocable_v<Handler&, TlvT<Cmd>&&>)
+			{
+				return &DecodeAndHandle<Handler, Cmd>;
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+		template <typename Handler, typename CmdList = ReadableTlvCmds>
+		struct DispatchTable;
+
+		/// @brief  以 Cmd 为下标的解码函数表，由 CmdList 在编译期生成
+		/// @remark handler 不接受的 Tlv 对应的项为 nullptr
+		template <typename Handler, std::uint16_t... Cmds>
+		struct DispatchTable<Handler, std::integer_sequence<std::uint16_t, Cmds...>>
+		{
+			using CmdList = std::integer_sequence<std::uint16_t, Cmds...>;
+
+			static_assert(IsCompleteReadableTlvList<CmdList>,
+			              "Every readable Tlv should be listed in ReadableTlvCmds.");
+
+			using DecodeFunction = void (*)(Handler& handler, gsl::span<const std::byte> const& body);
+
+			static constexpr std::uint16_t SortedCmds[]{ Cmds... };
+			/// @brief  列表已排序，因此最后一项即为最大的 Cmd
+			static constexpr std::size_t Size = SortedCmds[sizeof...(Cmds) - 1] + std::size_t{ 1 };
+
+			static constexpr std::array<DecodeFunction, Size> Entries = [] {
+				std::array<DecodeFunction, Size> entries{};
+				((entries[Cmds] = GetDecodeFunction<Handler, Cmds>()), ...);
+				return entries;
+			}();
+
+			/// @return handler 不接受该 Tlv 或该 Tlv 不可读取时返回 false
+			static bool Dispatch(Handler& handler, std::uint16_t cmd,
+			                     gsl::span<const std::byte> const& body)
+			{
+				if (cmd >= Size)
+				{
+					return false;
+				}
+
+				const auto decode = Entries[cmd];
+				if (!decode)
+				{
+					return false;
+				}
+
+				decode(handler, body);
+				return true;
+			}
+		};
+
+		template <typename Handler, typename Fallback>
+		void DispatchEntry(Handler& handler, Fallback& fallback, std::uint16_t cmd,
+		                   gsl::span<const std::byte> const& body)
+		{
+			if (!DispatchTable<Handler>::Dispatch(handler, cmd, body))
+			{
+				std::invoke(fallback, cmd, body);
+			}
+		}
+	} // namespace Detail
+
+	/// @brief  按顺序遍历一次 data 中的所有 Tlv 并分派
+	/// @remark 可读取且 handler 可以 TlvT<Cmd>&& 调用的 Tlv 将解码后交给 handler，
+	///         其余的 Tlv 以 (std::uint16_t cmd, gsl::span<const std::byte> body) 交给 fallback
+	///         不建立索引，Body 的大小超出剩余部分时，将忽略该 Tlv 及其后的内容
+	template <typename Handler, typename Fallback>
+	void DispatchTlv(gsl::span<const std::byte> const& data, Handler&& handler, Fallback&& fallback)
+	{
+		const auto dataSize = static_cast<std::size_t>(data.size());
+		for (std::size_t offset = 0; dataSize - offset >= 4;)
+		{
+			const auto cmd = Utility::LoadBigEndian<std::uint16_t>(data.data() + offset);
+			const auto bodySize = Utility::LoadBigEndian<std::uint16_t>(data.data() + offset + 2);
+			offset += 4;
+			if (dataSize - offset < bodySize)
+			{
+				break;
+			}
+
+			Detail::DispatchEntry(handler, fallback, cmd, data.subspan(offset, bodySize));
+			offset += bodySize;
+		}
+	}
+
+	/// @brief  按顺序分派 reader 中的所有 Tlv
+	/// @see    DispatchTlv(gsl::span<const std::byte> const&, Handler&&, Fallback&&)
+	template <typename Handler, typename Fallback>
+	void DispatchTlv(TlvReader& reader, Handler&& handler, Fallback&& fallback)
+	{
+		for (const auto& entry : reader.GetEntries())
+		{
+			Detail::DispatchEntry(handler, fallback, entry.Cmd, reader.GetBody(entry));
+		}
+	}
 } // namespace YumeBot::Tlv
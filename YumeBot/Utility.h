@@ -1,9 +1,19 @@
 ﻿#pragma once
+#include <bit>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <gsl/span>
+#include <mutex>
 #include <type_traits>
 
+#ifdef _MSC_VER
+#	include <stdlib.h>
+#endif
+
 namespace YumeBot::Utility
 {
 	constexpr std::size_t AlignTo(std::size_t num, std::size_t alignment) noexcept
@@ -219,6 +229,84 @@ namespace YumeBot::Utility
 		    std::make_index_sequence<std::tuple_size_v<std::remove_reference_t<Tuple>>>());
 	}
 
+	/// @brief  反转整数的字节序
+	template <typename T>
+	T ByteSwap(T value) noexcept
+	{
+		static_assert(std::is_integral_v<T>, "T should be an integral type.");
+		using UnsignedType = std::make_unsigned_t<T>;
+		const auto unsignedValue = static_cast<UnsignedType>(value);
+
+		if constexpr (sizeof(T) == 1)
+		{
+			return value;
+		}
+#ifdef _MSC_VER
+		else if constexpr (sizeof(T) == 2)
+		{
+			return static_cast<T>(_byteswap_ushort(unsignedValue));
+		}
+		else if constexpr (sizeof(T) == 4)
+		{
+			return static_cast<T>(_byteswap_ulong(unsignedValue));
+		}
+		else
+		{
+			static_assert(sizeof(T) == 8);
+			return static_cast<T>(_byteswap_uint64(unsignedValue));
+		}
+#else
+		else if constexpr (sizeof(T) == 2)
+		{
+			return static_cast<T>(__builtin_bswap16(unsignedValue));
+		}
+		else if constexpr (sizeof(T) == 4)
+		{
+			return static_cast<T>(__builtin_bswap32(unsignedValue));
+		}
+		else
+		{
+			static_assert(sizeof(T) == 8);
+			return static_cast<T>(__builtin_bswap64(unsignedValue));
+		}
+#endif
+	}
+
+	/// @brief  以大端序将 value 写入 dest 起始的 sizeof(T) 个字节
+	template <typename T>
+	void StoreBigEndian(std::byte* dest, T value) noexcept
+	{
+		static_assert(std::is_integral_v<T>, "T should be an integral type.");
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			value = ByteSwap(value);
+		}
+		std::memcpy(dest, &value, sizeof(T));
+	}
+
+	/// @brief  以大端序读取 src 起始的 sizeof(T) 个字节
+	template <typename T>
+	T LoadBigEndian(std::byte const* src) noexcept
+	{
+		static_assert(std::is_integral_v<T>, "T should be an integral type.");
+		T value;
+		std::memcpy(&value, src, sizeof(T));
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			value = ByteSwap(value);
+		}
+		return value;
+	}
+
+	/// @brief  以大端序依次将 values 紧密地写入 dest
+	/// @return 写入部分的末尾
+	template <typename... T>
+	std::byte* PackBigEndian(std::byte* dest, T... values) noexcept
+	{
+		((StoreBigEndian(dest, values), dest += sizeof(T)), ...);
+		return dest;
+	}
+
 	inline std::uint32_t GetPosixTime() noexcept
 	{
 		const auto count = std::chrono::duration_cast<std::chrono::seconds>(
@@ -227,4 +315,69 @@ namespace YumeBot::Utility
 		assert(count <= std::numeric_limits<std::uint32_t>::max());
 		return static_cast<std::uint32_t>(count);
 	}
+
+	/// @brief  由用户提供的执行器，应在任意线程（包括调用者所在线程）上执行传入的任务
+	using Executor = std::function<void(std::function<void()>)>;
+
+	/// @brief  通过 executor 对 [0, count) 中的每个下标调用 func，所有调用完成后才返回
+	/// @remark 若有调用抛出了异常，将在所有调用完成后重新抛出第一个异常
+	///         若 executor 抛出异常，将不再提交剩余的任务，在已提交的任务完成后重新抛出该异常
+	///         executor 不应在所有任务完成前阻塞调用者，否则可能死锁
+	template <typename Func>
+	void ParallelFor(Executor const& executor, std::size_t count, Func&& func)
+	{
+		if (!count)
+		{
+			return;
+		}
+
+		std::mutex mutex;
+		std::condition_variable finishedCondition;
+		std::size_t remainCount = count;
+		std::exception_ptr exception;
+
+		std::size_t i = 0;
+		try
+		{
+			for (; i < count; ++i)
+			{
+				executor([&, i] {
+					std::exception_ptr currentException;
+					try
+					{
+						func(i);
+					}
+					catch (...)
+					{
+						currentException = std::current_exception();
+					}
+
+					std::lock_guard lock{ mutex };
+					if (currentException && !exception)
+					{
+						exception = std::move(currentException);
+					}
+					if (!--remainCount)
+					{
+						finishedCondition.notify_all();
+					}
+				});
+			}
+		}
+		catch (...)
+		{
+			// 已提交的任务仍引用以上的局部变量，必须等待其完成后才能离开
+			std::unique_lock lock{ mutex };
+			remainCount -= count - i;
+			finishedCondition.wait(lock, [&] { return !remainCount; });
+			throw;
+		}
+
+		std::unique_lock lock{ mutex };
+		finishedCondition.wait(lock, [&] { return !remainCount; });
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
 } // namespace YumeBot::Utility
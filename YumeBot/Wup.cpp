@@ -10,6 +10,173 @@ using namespace YumeBot;
 using namespace Jce;
 using namespace Wup;
 
+namespace
+{
+	constexpr std::uint64_t Fnv1aOffsetBasis = 0xCBF29CE484222325;
+	constexpr std::uint64_t Fnv1aPrime = 0x100000001B3;
+
+	std::uint64_t HashNames(gsl::span<const std::byte> const& servantName,
+	                        gsl::span<const std::byte> const& funcName, std::uint64_t seed) noexcept
+	{
+		auto hash = Fnv1aOffsetBasis ^ (seed * Fnv1aPrime);
+		for (const auto byte : servantName)
+		{
+			hash = (hash ^ static_cast<std::uint8_t>(byte)) * Fnv1aPrime;
+		}
+		// 分隔两个名称，避免 ("ab", "c") 与 ("a", "bc") 总是冲突
+		hash = (hash ^ 0xFF) * Fnv1aPrime;
+		for (const auto byte : funcName)
+		{
+			hash = (hash ^ static_cast<std::uint8_t>(byte)) * Fnv1aPrime;
+		}
+		return hash ^ (hash >> 32);
+	}
+
+	bool NameEquals(std::vector<std::byte> const& name,
+	                gsl::span<const std::byte> const& bytes) noexcept
+	{
+		return name.size() == static_cast<std::size_t>(bytes.size()) &&
+		       std::equal(name.cbegin(), name.cend(), bytes.begin());
+	}
+
+	/// @brief  不解码整个帧，直接从 UniPacket 帧中定位 sServantName 及 sFuncName 的字节
+	std::optional<std::pair<gsl::span<const std::byte>, gsl::span<const std::byte>>>
+	FindNamesInFrame(gsl::span<const std::byte> const& frame) noexcept
+	{
+		std::size_t pos = sizeof(std::uint32_t);
+		const auto frameSize = static_cast<std::size_t>(frame.size());
+
+		const auto readUInt = [&](std::size_t size) -> std::optional<std::uint32_t> {
+			if (frameSize - pos < size)
+			{
+				return {};
+			}
+			// Jce 流使用小端序
+			std::uint32_t value = 0;
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				value |= static_cast<std::uint32_t>(frame[pos + i]) << (i * 8);
+			}
+			pos += size;
+			return value;
+		};
+
+		const auto readHead = [&]() -> std::optional<HeadData> {
+			const auto byte = readUInt(1);
+			if (!byte)
+			{
+				return {};
+			}
+			const auto type = static_cast<JceStruct::TypeEnum>(*byte & 0x0F);
+			const auto tag = *byte >> 4;
+			if (tag != 0x0F)
+			{
+				return HeadData{ tag, type };
+			}
+			const auto extendedTag = readUInt(1);
+			if (!extendedTag)
+			{
+				return {};
+			}
+			return HeadData{ *extendedTag, type };
+		};
+
+		const auto readString = [&]() -> std::optional<gsl::span<const std::byte>> {
+			const auto head = readHead();
+			if (!head)
+			{
+				return {};
+			}
+			std::optional<std::uint32_t> size;
+			switch (head->Type)
+			{
+			case JceStruct::TypeEnum::String1:
+				size = readUInt(1);
+				break;
+			case JceStruct::TypeEnum::String4:
+				size = readUInt(4);
+				break;
+			default:
+				return {};
+			}
+			if (!size || frameSize - pos < *size)
+			{
+				return {};
+			}
+			const auto result = frame.subspan(pos, *size);
+			pos += *size;
+			return result;
+		};
+
+		if (pos > frameSize)
+		{
+			return {};
+		}
+
+		const auto structHead = readHead();
+		if (!structHead || structHead->Type != JceStruct::TypeEnum::StructBegin)
+		{
+			return {};
+		}
+
+		// 跳过 iVersion、cPacketType、iMessageType 及 iRequestId，均为整数
+		while (true)
+		{
+			const auto headPos = pos;
+			const auto head = readHead();
+			if (!head)
+			{
+				return {};
+			}
+			if (head->Tag >= 5)
+			{
+				pos = headPos;
+				break;
+			}
+
+			std::size_t valueSize;
+			switch (head->Type)
+			{
+			case JceStruct::TypeEnum::ZeroTag:
+				valueSize = 0;
+				break;
+			case JceStruct::TypeEnum::Byte:
+				valueSize = 1;
+				break;
+			case JceStruct::TypeEnum::Short:
+				valueSize = 2;
+				break;
+			case JceStruct::TypeEnum::Int:
+				valueSize = 4;
+				break;
+			case JceStruct::TypeEnum::Long:
+				valueSize = 8;
+				break;
+			default:
+				return {};
+			}
+			if (frameSize - pos < valueSize)
+			{
+				return {};
+			}
+			pos += valueSize;
+		}
+
+		const auto servantName = readString();
+		if (!servantName)
+		{
+			return {};
+		}
+		const auto funcName = readString();
+		if (!funcName)
+		{
+			return {};
+		}
+
+		return std::pair{ *servantName, *funcName };
+	}
+} // namespace
+
 UsingStringView Wup::Detail::GetName(std::shared_ptr<JceStruct> const& value) noexcept
 {
 	return value->GetJceStructName();
@@ -36,15 +203,103 @@ void OldUniAttribute::Decode(Cafe::Io::InputStream* stream)
 	}
 }
 
-UniPacket::UniPacket() : m_OldRespIRet{}
+bool UniAttribute::Remove(UsingString const& name)
+{
+	return !!m_Data.erase(name);
+}
+
+void UniAttribute::Encode(Cafe::Io::OutputStream* stream) const
+{
+	JceOutputStream output{ stream };
+	output.Write(0, m_Data);
+}
+
+void UniAttribute::Decode(Cafe::Io::InputStream* stream)
+{
+	JceInputStream input{ stream };
+	m_Data.clear();
+	if (!input.Read(0, m_Data))
+	{
+		CAFE_THROW(CafeException, u8"Data is corrupted"_sv);
+	}
+}
+
+UniPacket::UniPacket(std::int16_t version) : m_OldRespIRet{}
+{
+	m_RequestPacket.SetiVersion(version);
+	m_RequestPacket.SetiMessageType(0);
+	m_RequestPacket.SetiRequestId(0);
+	m_RequestPacket.SetiTimeout(0);
+	ResetAttribute();
+}
+
+void UniPacket::SetVersion(std::int16_t version)
+{
+	m_RequestPacket.SetiVersion(version);
+	if (IsUniAttributeVersion(version) != std::holds_alternative<UniAttribute>(m_UniAttribute))
+	{
+		ResetAttribute();
+	}
+}
+
+bool UniPacket::Remove(UsingString const& name)
+{
+	return std::visit([&](auto& attribute) { return attribute.Remove(name); }, m_UniAttribute);
+}
+
+void UniPacket::ResetAttribute()
+{
+	if (IsUniAttributeVersion(m_RequestPacket.GetiVersion()))
+	{
+		m_UniAttribute.emplace<UniAttribute>();
+	}
+	else
+	{
+		m_UniAttribute.emplace<OldUniAttribute>();
+	}
+}
+
+void UniPacket::EncodeAttribute(Cafe::Io::OutputStream* stream) const
 {
+	if (IsUniAttributeVersion(m_RequestPacket.GetiVersion()) !=
+	    std::holds_alternative<UniAttribute>(m_UniAttribute))
+	{
+		CAFE_THROW(CafeException,
+		           u8"Attribute format does not match iVersion, use SetVersion instead."_sv);
+	}
+
+	std::visit([&](auto const& attribute) { attribute.Encode(stream); }, m_UniAttribute);
+}
+
+gsl::span<const std::byte> UniPacket::DecodeRequestPacket(Cafe::Io::InputStream* stream)
+{
+	const auto underlyingStream = dynamic_cast<SeekableStreamBase*>(stream);
+	assert(underlyingStream);
+	underlyingStream->Seek(SeekOrigin::Current, 4);
+	JceInputStream is{ stream };
+	if (!is.Read(0, m_RequestPacket))
+	{
+		CAFE_THROW(CafeException, u8"Read RequestPacket failed."_sv);
+	}
+
+	ResetAttribute();
+
+	const auto& buffer = m_RequestPacket.GetsBuffer();
+	return gsl::as_bytes(gsl::make_span(buffer.data(), buffer.size()));
 }
 
 void UniPacket::Encode(Cafe::Io::OutputStream* stream)
 {
 	MemoryStream tmpBuffer;
-	m_UniAttribute.Encode(&tmpBuffer);
-	const auto buffer = tmpBuffer.GetInternalStorage();
+	EncodeRequestPacket(stream, tmpBuffer);
+}
+
+void UniPacket::EncodeRequestPacket(Cafe::Io::OutputStream* stream, MemoryStream& attributeBuffer)
+{
+	attributeBuffer.SeekFromBegin(0);
+	EncodeAttribute(&attributeBuffer);
+	const auto buffer =
+	    attributeBuffer.GetInternalStorage().subspan(0, attributeBuffer.GetPosition());
 	m_RequestPacket.GetsBuffer().assign(buffer.data(), buffer.data() + buffer.size());
 
 	Cafe::Io::BinaryWriter writer{ stream, std::endian::little };
@@ -66,34 +321,43 @@ void UniPacket::Encode(Cafe::Io::OutputStream* stream)
 
 void UniPacket::Decode(Cafe::Io::InputStream* stream)
 {
-	const auto underlyingStream = dynamic_cast<SeekableStreamBase*>(stream);
-	assert(underlyingStream);
-	underlyingStream->Seek(SeekOrigin::Current, 4);
-	JceInputStream is{ stream };
-	if (!is.Read(0, m_RequestPacket))
+	ExternalMemoryInputStream bufferStream{ DecodeRequestPacket(stream) };
+	std::visit([&](auto& attribute) { attribute.Decode(&bufferStream); }, m_UniAttribute);
+}
+
+UniPacketBatch UniPacket::EncodeBatch(gsl::span<UniPacket> const& packets)
+{
+	UniPacketBatch result;
+	result.Offsets.reserve(packets.size() + 1);
+
+	// 复用同一个临时缓冲区编码各个包的属性，并将所有包依次编码到同一个流中
+	MemoryStream attributeBuffer;
+	MemoryStream batchStream;
+	for (auto& packet : packets)
 	{
-		CAFE_THROW(CafeException, u8"Read RequestPacket failed."_sv);
+		result.Offsets.emplace_back(batchStream.GetPosition());
+		packet.EncodeRequestPacket(&batchStream, attributeBuffer);
 	}
+	result.Offsets.emplace_back(batchStream.GetPosition());
 
-	const auto& buffer = m_RequestPacket.GetsBuffer();
-	ExternalMemoryInputStream bufferStream{ gsl::as_bytes(gsl::make_span(buffer.data(), buffer.size())) };
-	m_UniAttribute.Decode(&bufferStream);
+	const auto encoded = batchStream.GetInternalStorage();
+	result.Buffer.assign(encoded.begin(), encoded.end());
+	return result;
 }
 
 UniPacket UniPacket::CreateResponse()
 {
-	UniPacket result;
+	UniPacket result{ m_RequestPacket.GetiVersion() };
 	result.m_RequestPacket.SetiRequestId(m_RequestPacket.GetiRequestId());
 	result.m_RequestPacket.SetsServantName(m_RequestPacket.GetsServantName());
 	result.m_RequestPacket.SetsFuncName(m_RequestPacket.GetsFuncName());
-	result.m_RequestPacket.SetiVersion(m_RequestPacket.GetiVersion());
 	return result;
 }
 
 void UniPacket::CreateOldRespEncode(JceOutputStream& os)
 {
 	MemoryStream memoryStream;
-	m_UniAttribute.Encode(&memoryStream);
+	EncodeAttribute(&memoryStream);
 
 	os.Write(1, m_RequestPacket.GetiVersion());
 	os.Write(2, m_RequestPacket.GetcPacketType());
@@ -104,3 +368,351 @@ void UniPacket::CreateOldRespEncode(JceOutputStream& os)
 	os.Write(6, internalStorage);
 	os.Write(7, m_RequestPacket.Getstatus());
 }
+
+RequestCorrelator::RequestCorrelator(std::size_t capacity) : m_PendingCount{}, m_DeletedCount{}
+{
+	std::size_t slotCount = 1;
+	while (slotCount < capacity)
+	{
+		slotCount <<= 1;
+	}
+
+	m_Slots = std::make_unique<Slot[]>(slotCount);
+	m_Mask = slotCount - 1;
+	m_ProbeCoverage = std::make_unique<std::ptrdiff_t[]>(slotCount);
+}
+
+bool RequestCorrelator::Register(RequestPacket const& request, CompletionCallback callback)
+{
+	const auto requestId = request.GetiRequestId();
+	const auto timeout = request.GetiTimeout();
+	const auto deadline =
+	    timeout > 0 ? Clock::now() + std::chrono::milliseconds{ timeout } : Clock::time_point::max();
+
+	// Deleted 的槽不会中断探测链，不清理时所有槽最终都将不再为 Empty，使每次查找都检查整个表
+	if (m_DeletedCount.load(std::memory_order_relaxed) > (m_Mask + 1) / 4)
+	{
+		PurgeDeleted();
+	}
+
+	// 需检查整条探测链以拒绝重复的 iRequestId，登记到其中首个空闲的槽
+	Slot* freeSlot = nullptr;
+	Tag freeTag{};
+	const auto beginIndex = GetSlotIndex(requestId);
+	for (std::size_t i = 0; i <= m_Mask; ++i)
+	{
+		auto& slot = m_Slots[(beginIndex + i) & m_Mask];
+		const auto tag = slot.SlotTag.load(std::memory_order_acquire);
+		const auto state = GetState(tag);
+		if (state == SlotState::Pending && GetRequestId(tag) == requestId)
+		{
+			return false;
+		}
+
+		if ((state == SlotState::Empty || state == SlotState::Deleted) && !freeSlot)
+		{
+			freeSlot = &slot;
+			freeTag = tag;
+		}
+
+		if (state == SlotState::Empty)
+		{
+			// 探测链在此中断，之后不可能存在该请求
+			break;
+		}
+	}
+
+	if (!freeSlot)
+	{
+		return false;
+	}
+
+	if (GetState(freeTag) == SlotState::Deleted)
+	{
+		m_DeletedCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// 只有登记线程会将空闲的槽转为 Pending，因此此处无需 CAS
+	freeSlot->Callback = std::move(callback);
+	freeSlot->Deadline.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+	freeSlot->SlotTag.store(MakeTag(SlotState::Pending, GetGeneration(freeTag) + 1, requestId),
+	                        std::memory_order_release);
+	m_PendingCount.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool RequestCorrelator::Complete(UniPacket& response)
+{
+	const auto requestId = response.GetRequestPacket().GetiRequestId();
+	const auto beginIndex = GetSlotIndex(requestId);
+	for (std::size_t i = 0; i <= m_Mask; ++i)
+	{
+		auto& slot = m_Slots[(beginIndex + i) & m_Mask];
+		auto tag = slot.SlotTag.load(std::memory_order_acquire);
+		const auto state = GetState(tag);
+		if (state == SlotState::Empty)
+		{
+			// 探测链在此中断，之后不可能存在该请求
+			break;
+		}
+
+		if (state != SlotState::Pending || GetRequestId(tag) != requestId)
+		{
+			continue;
+		}
+
+		// 状态与 RequestId 一同比较，失败时该请求已由其他线程完成或超时，槽不会进入中间状态
+		const auto completingTag = WithState(tag, SlotState::Completing);
+		if (!slot.SlotTag.compare_exchange_strong(tag, completingTag, std::memory_order_acq_rel))
+		{
+			continue;
+		}
+
+		const auto callback = Take(slot, completingTag);
+		if (callback)
+		{
+			callback(&response);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+std::size_t RequestCorrelator::ExpireTimedOut(Clock::time_point now)
+{
+	const auto nowTicks = now.time_since_epoch().count();
+	std::size_t expiredCount = 0;
+	for (std::size_t i = 0; i <= m_Mask; ++i)
+	{
+		auto& slot = m_Slots[i];
+		auto tag = slot.SlotTag.load(std::memory_order_acquire);
+		if (GetState(tag) != SlotState::Pending ||
+		    slot.Deadline.load(std::memory_order_relaxed) >= nowTicks)
+		{
+			continue;
+		}
+
+		// 槽被复用时代数必然改变，因此 CAS 成功时读取的截止时间属于同一个请求
+		const auto completingTag = WithState(tag, SlotState::Completing);
+		if (!slot.SlotTag.compare_exchange_strong(tag, completingTag, std::memory_order_acq_rel))
+		{
+			continue;
+		}
+
+		const auto callback = Take(slot, completingTag);
+		if (callback)
+		{
+			callback(nullptr);
+		}
+		++expiredCount;
+	}
+
+	return expiredCount;
+}
+
+std::size_t RequestCorrelator::GetPendingCount() const noexcept
+{
+	return m_PendingCount.load(std::memory_order_relaxed);
+}
+
+std::size_t RequestCorrelator::GetProbeLength(std::int32_t requestId) const noexcept
+{
+	const auto beginIndex = GetSlotIndex(requestId);
+	for (std::size_t i = 0; i <= m_Mask; ++i)
+	{
+		const auto tag = m_Slots[(beginIndex + i) & m_Mask].SlotTag.load(std::memory_order_acquire);
+		const auto state = GetState(tag);
+		if (state == SlotState::Empty)
+		{
+			return i + 1;
+		}
+
+		if (state == SlotState::Pending && GetRequestId(tag) == requestId)
+		{
+			return i + 1;
+		}
+	}
+
+	return m_Mask + 1;
+}
+
+std::size_t RequestCorrelator::GetSlotIndex(std::int32_t requestId) const noexcept
+{
+	// iRequestId 通常是连续分配的，直接取低位即可均匀分布
+	return static_cast<std::uint32_t>(requestId) & m_Mask;
+}
+
+RequestCorrelator::CompletionCallback RequestCorrelator::Take(Slot& slot, Tag completingTag)
+{
+	auto callback = std::move(slot.Callback);
+	slot.Callback = nullptr;
+	// 置为 Deleted 而不是 Empty 以免中断其他请求的探测链，登记时可复用
+	slot.SlotTag.store(WithState(completingTag, SlotState::Deleted), std::memory_order_release);
+	m_DeletedCount.fetch_add(1, std::memory_order_relaxed);
+	m_PendingCount.fetch_sub(1, std::memory_order_relaxed);
+	return callback;
+}
+
+void RequestCorrelator::PurgeDeleted()
+{
+	// 请求所在的槽与其起始槽之间的槽都在其探测链上，以差分形式累计，绕回表头的部分计入 wrapped
+	const auto slotCount = m_Mask + 1;
+	std::fill_n(m_ProbeCoverage.get(), slotCount, 0);
+	std::ptrdiff_t wrapped = 0;
+	for (std::size_t i = 0; i < slotCount; ++i)
+	{
+		const auto tag = m_Slots[i].SlotTag.load(std::memory_order_acquire);
+		const auto state = GetState(tag);
+		if (state != SlotState::Pending && state != SlotState::Completing)
+		{
+			continue;
+		}
+
+		const auto beginIndex = GetSlotIndex(GetRequestId(tag));
+		++m_ProbeCoverage[beginIndex];
+		--m_ProbeCoverage[i];
+		if (beginIndex > i)
+		{
+			++wrapped;
+		}
+	}
+
+	// 期间完成的请求只会使统计偏于保守，已统计的 Deleted 槽只有本线程会修改
+	auto coverage = wrapped;
+	for (std::size_t i = 0; i < slotCount; ++i)
+	{
+		coverage += m_ProbeCoverage[i];
+		auto& slot = m_Slots[i];
+		const auto tag = slot.SlotTag.load(std::memory_order_acquire);
+		if (coverage == 0 && GetState(tag) == SlotState::Deleted)
+		{
+			slot.SlotTag.store(WithState(tag, SlotState::Empty), std::memory_order_release);
+			m_DeletedCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+void ServantDispatcher::Register(UsingStringView const& servantName,
+                                 UsingStringView const& funcName, Handler handler)
+{
+	const auto servantNameBytes = gsl::as_bytes(servantName.GetTrimmedSpan());
+	const auto funcNameBytes = gsl::as_bytes(funcName.GetTrimmedSpan());
+	auto& entry = m_Entries.emplace_back();
+	entry.ServantName.assign(servantNameBytes.begin(), servantNameBytes.end());
+	entry.FuncName.assign(funcNameBytes.begin(), funcNameBytes.end());
+	entry.Callback = std::move(handler);
+	m_Table.clear();
+}
+
+void ServantDispatcher::Build()
+{
+	constexpr std::uint64_t MaxSeedTries = 64;
+
+	m_Table.clear();
+	if (m_Entries.empty())
+	{
+		return;
+	}
+
+	std::size_t tableSize = 1;
+	while (tableSize < m_Entries.size() * 2)
+	{
+		tableSize <<= 1;
+	}
+
+	while (true)
+	{
+		m_Mask = tableSize - 1;
+		for (std::uint64_t seed = 0; seed < MaxSeedTries; ++seed)
+		{
+			m_Seed = seed;
+			m_Table.assign(tableSize, 0);
+
+			bool succeed = true;
+			for (std::size_t i = 0; i < m_Entries.size(); ++i)
+			{
+				const auto& entry = m_Entries[i];
+				auto& slot = m_Table[GetTableIndex(entry.ServantName, entry.FuncName)];
+				if (slot)
+				{
+					const auto& conflictEntry = m_Entries[slot - 1];
+					if (conflictEntry.ServantName == entry.ServantName &&
+					    conflictEntry.FuncName == entry.FuncName)
+					{
+						m_Table.clear();
+						CAFE_THROW(CafeException, u8"Duplicated servant and function name."_sv);
+					}
+
+					succeed = false;
+					break;
+				}
+				slot = static_cast<std::uint32_t>(i + 1);
+			}
+
+			if (succeed)
+			{
+				return;
+			}
+		}
+
+		tableSize <<= 1;
+	}
+}
+
+ServantDispatcher::Handler const*
+ServantDispatcher::Find(gsl::span<const std::byte> const& servantName,
+                        gsl::span<const std::byte> const& funcName) const noexcept
+{
+	assert((m_Entries.empty() || !m_Table.empty()) && "Build should be called before dispatching.");
+	if (m_Table.empty())
+	{
+		return nullptr;
+	}
+
+	const auto slot = m_Table[GetTableIndex(servantName, funcName)];
+	if (!slot)
+	{
+		return nullptr;
+	}
+
+	const auto& entry = m_Entries[slot - 1];
+	if (!NameEquals(entry.ServantName, servantName) || !NameEquals(entry.FuncName, funcName))
+	{
+		return nullptr;
+	}
+
+	return &entry.Callback;
+}
+
+ServantDispatcher::Handler const*
+ServantDispatcher::Find(RequestPacket const& packet) const noexcept
+{
+	return Find(gsl::as_bytes(packet.GetsServantName().GetView().GetTrimmedSpan()),
+	            gsl::as_bytes(packet.GetsFuncName().GetView().GetTrimmedSpan()));
+}
+
+bool ServantDispatcher::Dispatch(gsl::span<const std::byte> const& frame) const
+{
+	const auto names = FindNamesInFrame(frame);
+	if (!names)
+	{
+		return false;
+	}
+
+	const auto handler = Find(names->first, names->second);
+	if (!handler)
+	{
+		return false;
+	}
+
+	(*handler)(frame);
+	return true;
+}
+
+std::size_t
+ServantDispatcher::GetTableIndex(gsl::span<const std::byte> const& servantName,
+                                 gsl::span<const std::byte> const& funcName) const noexcept
+{
+	return static_cast<std::size_t>(HashNames(servantName, funcName, m_Seed)) & m_Mask;
+}
@@ -2,6 +2,11 @@
 #include "Jce.h"
 #include <Cafe/Io/Streams/MemoryStream.h>
 #include <Cafe/TextUtils/Format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <variant>
 
 namespace YumeBot::Jce::Wup
 {
@@ -171,14 +176,78 @@ namespace YumeBot::Jce::Wup
 		std::unordered_map<UsingString, std::unordered_map<UsingString, std::vector<std::byte>>> m_Data;
 	};
 
+	/// @brief  新版（iVersion 为 3）协议使用的属性集合
+	/// @remark 与 OldUniAttribute 不同，不再于每个键下嵌套类型名，而是直接保存名称到数据的映射
+	class UniAttribute
+	{
+	public:
+		template <typename T>
+		void Put(UsingString const& name, T const& value)
+		{
+			Cafe::Io::MemoryStream memoryStream;
+			JceOutputStream out{ &memoryStream };
+			out.Write(0, value);
+			memoryStream.SeekFromBegin(0);
+			const auto internalStorage = memoryStream.GetInternalStorage();
+			m_Data[name].assign(internalStorage.data(), internalStorage.data() + internalStorage.size());
+		}
+
+		template <typename T>
+		bool Get(UsingString const& name, T& result) const
+		{
+			const auto iter = m_Data.find(name);
+			if (iter == m_Data.cend())
+			{
+				CAFE_THROW(Cafe::ErrorHandling::CafeException,
+				           Cafe::TextUtils::FormatString(CAFE_UTF8_SV("No such key(\"${0}\")."), name));
+			}
+
+			Cafe::Io::ExternalMemoryInputStream stream{ gsl::as_bytes(
+				  gsl::make_span(iter->second.data(), iter->second.size())) };
+			JceInputStream in{ &stream };
+
+			return in.Read(0, result);
+		}
+
+		bool Remove(UsingString const& name);
+
+		void Encode(Cafe::Io::OutputStream* stream) const;
+		void Decode(Cafe::Io::InputStream* stream);
+
+	private:
+		std::unordered_map<UsingString, std::vector<std::byte>> m_Data;
+	};
+
+	/// @brief  批量编码的结果
+	struct UniPacketBatch
+	{
+		std::vector<std::byte> Buffer;
+		/// @brief  第 i 个包位于 Buffer 的 [Offsets[i], Offsets[i + 1]) 范围内
+		std::vector<std::size_t> Offsets;
+	};
+
 	class UniPacket
 	{
 	public:
-		UniPacket();
+		/// @brief  使用 OldUniAttribute 编码属性的协议版本
+		static constexpr std::int16_t OldUniAttributeVersion = 2;
+		/// @brief  使用 UniAttribute 编码属性的协议版本
+		static constexpr std::int16_t UniAttributeVersion = 3;
+
+		using AttributeType = std::variant<OldUniAttribute, UniAttribute>;
+
+		explicit UniPacket(std::int16_t version = OldUniAttributeVersion);
 
 		void Encode(Cafe::Io::OutputStream* stream);
+		/// @remark 属性的值以未解码的字节保存，直到以具体的类型调用 Get 时才解码
+		///         因此解码属性只是单趟扫描并复制各个条目，耗时与复制数据相当，无法从并行中获益
 		void Decode(Cafe::Io::InputStream* stream);
 
+		/// @brief  将多个包首尾相接地编码到同一块缓冲区内，每个包的格式与 Encode 相同
+		/// @remark 每个包与 Encode 一样经由 JceOutputStream 编码，之后回填长度
+		///         属性的临时缓冲区及输出的流在各个包之间复用
+		static UniPacketBatch EncodeBatch(gsl::span<UniPacket> const& packets);
+
 		UniPacket CreateResponse();
 		void CreateOldRespEncode(JceOutputStream& os);
 
@@ -187,11 +256,30 @@ namespace YumeBot::Jce::Wup
 			return m_RequestPacket;
 		}
 
-		OldUniAttribute& GetAttribute() noexcept
+		/// @brief  设置协议版本，并按版本选择属性的编码格式
+		/// @remark 若格式发生变化，已放入的属性将被清空
+		void SetVersion(std::int16_t version);
+
+		AttributeType& GetAttribute() noexcept
 		{
 			return m_UniAttribute;
 		}
 
+		template <typename T>
+		void Put(UsingString const& name, T const& value)
+		{
+			std::visit([&](auto& attribute) { attribute.Put(name, value); }, m_UniAttribute);
+		}
+
+		template <typename T>
+		bool Get(UsingString const& name, T& result) const
+		{
+			return std::visit([&](auto const& attribute) { return attribute.Get(name, result); },
+			                  m_UniAttribute);
+		}
+
+		bool Remove(UsingString const& name);
+
 		std::int32_t GetOldRespIRet() const noexcept
 		{
 			return m_OldRespIRet;
@@ -204,7 +292,155 @@ namespace YumeBot::Jce::Wup
 
 	private:
 		RequestPacket m_RequestPacket;
-		OldUniAttribute m_UniAttribute;
+		AttributeType m_UniAttribute;
 		std::int32_t m_OldRespIRet;
+
+		static constexpr bool IsUniAttributeVersion(std::int16_t version) noexcept
+		{
+			return version >= UniAttributeVersion;
+		}
+
+		void ResetAttribute();
+		void EncodeAttribute(Cafe::Io::OutputStream* stream) const;
+		/// @brief  以 attributeBuffer 作为临时缓冲区编码属性，之后编码带有长度前缀的包头
+		void EncodeRequestPacket(Cafe::Io::OutputStream* stream,
+		                         Cafe::Io::MemoryStream& attributeBuffer);
+		/// @brief  解码包头并按版本重置属性
+		/// @return 属性的编码结果，指向 m_RequestPacket 内的缓冲区
+		gsl::span<const std::byte> DecodeRequestPacket(Cafe::Io::InputStream* stream);
+	};
+
+	/// @brief  跟踪已发出但尚未收到响应的请求，以便在同一连接上流水线地发送请求并按 iRequestId
+	///         匹配乱序到达的响应
+	/// @remark 使用容量固定的开放寻址表，完成的请求留下的墓碑超过槽数的 1/4 时将在登记时清理
+	///         仅允许单一线程调用 Register，此时无需加锁，Complete 及 ExpireTimedOut 可在其他线程调用
+	class RequestCorrelator
+	{
+	public:
+		/// @brief  请求完成时的回调，response 为 nullptr 表示请求已超时
+		using CompletionCallback = std::function<void(UniPacket* response)>;
+		using Clock = std::chrono::steady_clock;
+
+		/// @param  capacity    最多同时等待响应的请求数，将向上取整到 2 的幂
+		explicit RequestCorrelator(std::size_t capacity = 256);
+
+		RequestCorrelator(RequestCorrelator const&) = delete;
+		RequestCorrelator& operator=(RequestCorrelator const&) = delete;
+
+		/// @brief  登记已发出的请求，截止时间由 iTimeout（毫秒）决定，非正值表示永不超时
+		/// @return 表已满或已有相同 iRequestId 的请求正在等待响应时返回 false
+		bool Register(RequestPacket const& request, CompletionCallback callback);
+
+		/// @brief  以响应完成对应的请求并调用其回调
+		/// @return 不存在对应的请求时返回 false
+		bool Complete(UniPacket& response);
+
+		/// @brief  使所有截止时间早于 now 的请求超时
+		/// @return 超时的请求数
+		std::size_t ExpireTimedOut(Clock::time_point now = Clock::now());
+
+		std::size_t GetPendingCount() const noexcept;
+
+		/// @brief  查找 requestId 对应的请求时需要检查的槽数，用于诊断
+		std::size_t GetProbeLength(std::int32_t requestId) const noexcept;
+
+	private:
+		enum class SlotState : std::uint8_t
+		{
+			Empty,
+			Pending,
+			Completing,
+			Deleted
+		};
+
+		/// @brief  槽的状态、代数及 RequestId 打包在同一个 64 位整数中，以便一次 CAS 同时比较
+		/// @remark 高 2 位为状态，之后 30 位为代数，低 32 位为 RequestId
+		///         每次登记时递增代数，使得槽被复用为相同 RequestId 的请求时 CAS 仍会失败
+		using Tag = std::uint64_t;
+
+		struct Slot
+		{
+			std::atomic<Tag> SlotTag{};
+			std::atomic<Clock::rep> Deadline{};
+			CompletionCallback Callback;
+		};
+
+		std::unique_ptr<Slot[]> m_Slots;
+		std::size_t m_Mask;
+		std::atomic<std::size_t> m_PendingCount;
+		std::atomic<std::size_t> m_DeletedCount;
+		/// @brief  清理墓碑时记录经过各个槽的探测链数目的差分，仅由登记线程使用
+		std::unique_ptr<std::ptrdiff_t[]> m_ProbeCoverage;
+
+		static constexpr Tag MakeTag(SlotState state, Tag generation, std::int32_t requestId) noexcept
+		{
+			return static_cast<Tag>(state) << 62 | (generation & 0x3FFFFFFF) << 32 |
+			       static_cast<std::uint32_t>(requestId);
+		}
+
+		static constexpr SlotState GetState(Tag tag) noexcept
+		{
+			return static_cast<SlotState>(tag >> 62);
+		}
+
+		static constexpr Tag GetGeneration(Tag tag) noexcept
+		{
+			return tag >> 32 & 0x3FFFFFFF;
+		}
+
+		static constexpr std::int32_t GetRequestId(Tag tag) noexcept
+		{
+			return static_cast<std::int32_t>(static_cast<std::uint32_t>(tag));
+		}
+
+		static constexpr Tag WithState(Tag tag, SlotState state) noexcept
+		{
+			return MakeTag(state, GetGeneration(tag), GetRequestId(tag));
+		}
+
+		std::size_t GetSlotIndex(std::int32_t requestId) const noexcept;
+		/// @brief  取出已转为 Completing 的槽的回调，并将槽置为 Deleted
+		CompletionCallback Take(Slot& slot, Tag completingTag);
+		/// @brief  将不在任何请求的探测链上的 Deleted 槽置为 Empty
+		/// @remark 只有登记线程会将槽由 Deleted 或 Empty 转为其他状态，因此只能由登记线程调用
+		void PurgeDeleted();
+	};
+
+	/// @brief  按 sServantName 及 sFuncName 分发收到的包
+	/// @remark 所有处理函数应在调用 Build 前注册，Build 将构建完美哈希表
+	///         分发时直接使用帧中未解码的名称字节查找，不进行分配且只需常数次比较
+	class ServantDispatcher
+	{
+	public:
+		/// @brief  frame 为 UniPacket::Encode 所产生格式的完整帧
+		using Handler = std::function<void(gsl::span<const std::byte> const& frame)>;
+
+		void Register(UsingStringView const& servantName, UsingStringView const& funcName,
+		              Handler handler);
+		void Build();
+
+		Handler const* Find(gsl::span<const std::byte> const& servantName,
+		                    gsl::span<const std::byte> const& funcName) const noexcept;
+		Handler const* Find(RequestPacket const& packet) const noexcept;
+
+		/// @return 帧格式无效或无对应的处理函数时返回 false
+		bool Dispatch(gsl::span<const std::byte> const& frame) const;
+
+	private:
+		struct Entry
+		{
+			std::vector<std::byte> ServantName;
+			std::vector<std::byte> FuncName;
+			Handler Callback;
+		};
+
+		std::vector<Entry> m_Entries;
+		// 保存 m_Entries 的下标 + 1，0 表示空位
+		std::vector<std::uint32_t> m_Table;
+		std::uint64_t m_Seed{};
+		std::size_t m_Mask{};
+
+		std::size_t GetTableIndex(gsl::span<const std::byte> const& servantName,
+		                          gsl::span<const std::byte> const& funcName) const noexcept;
 	};
 } // namespace YumeBot::Jce::Wup